@@ -1,66 +1,288 @@
 #include "Dispatcher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
+/**
+ * @brief Move events fired by the local timer from the scheduler zset to the tail of the
+ *        queue, skipping those that were rescheduled, removed or moved by another dispatcher
+ *        since they were fetched.  Running as a script makes the check and move atomic, so an
+ *        event is never queued twice.  Events are queued as "<type> <event id>", taking their
+ *        type from the types hash (0 if absent).
+ *        KEYS[1] - scheduler zset, KEYS[2] - queue, KEYS[3] - types hash
+ *        ARGV[1..] - pairs of event id and the score it was fetched with
+ *        Returns the number of events moved
+ */
+static const char *CONFIRM_SCRIPT = R"lua(
+local ids, moved = {}, {}
+for i = 1, #ARGV, 2 do
+    local score = redis.call('ZSCORE', KEYS[1], ARGV[i])
+    if score and tonumber(score) == tonumber(ARGV[i + 1]) then
+        redis.call('ZREM', KEYS[1], ARGV[i])
+        local type = redis.call('HGET', KEYS[3], ARGV[i]) or '0'
+        ids[#ids + 1] = ARGV[i]
+        moved[#moved + 1] = type .. ' ' .. ARGV[i]
+    end
+end
+if #moved > 0 then
+    redis.call('HDEL', KEYS[3], unpack(ids))
+    redis.call('RPUSH', KEYS[2], unpack(moved))
+end
+return #moved
+)lua";
+/**
+ * @brief Raise the window end recorded for producers to a dispatcher's new window end, so that
+ *        Scheduler::scheduleEvent() publishes events due within any dispatcher's window.
+ *        KEYS[1] - window end key
+ *        ARGV[1] - millisecond score at the end of the window
+ */
+static const char *WINDOW_SCRIPT = R"lua(
+local current = tonumber(redis.call('GET', KEYS[1]) or '0')
+if tonumber(ARGV[1]) > current then
+    redis.call('SET', KEYS[1], ARGV[1])
+end
+return 0
+)lua";
 
-Dispatcher::Dispatcher(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix):
+Dispatcher::Dispatcher(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, std::size_t batchSize,
+                       bool legacyScores, std::chrono::milliseconds lookAhead):
     m_redis(redis),
     m_logger(spdlog::get("scheduler")),
     m_schedulerKey(keyPrefix+"Zset"),
     m_queueKey(keyPrefix+"Queue"),
-    m_running(false),
-    m_dispatcher(std::thread(&Dispatcher::run, this))
+    m_typesKey(keyPrefix+"Types"),
+    m_wakeupChannel(keyPrefix+"Wakeup"),
+    m_windowEndKey(keyPrefix+"WindowEnd"),
+    m_batchSize(std::min(std::max<std::size_t>(batchSize, 1), MAX_BATCH)),
+    m_legacyScores(legacyScores),
+    m_lookAhead(std::max(lookAhead, std::chrono::milliseconds(1))),
+    m_confirmScript(CONFIRM_SCRIPT),
+    m_windowScript(WINDOW_SCRIPT),
+    m_windowEnd(),
+    m_running(true),
+    m_listenerStopped(false),
+    m_dispatcher(std::thread(&Dispatcher::run, this)),
+    m_listener(std::thread(&Dispatcher::listen, this))
 {
 
 }
 
 Dispatcher::~Dispatcher()
 {
-    m_running = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeup.notify_all();
+    // Unblock the listener, which may be waiting on a connection without a socket timeout.  Keep
+    // publishing in case it was still subscribing or reconnecting when first published to.
+    while (!m_listenerStopped.load()) {
+        try {
+            m_redis->publish(m_wakeupChannel, "");
+        } catch (const sw::redis::Error &err) {
+            m_logger->error("Dispatcher::~Dispatcher() Exception {}", err.what());
+        }
+        std::this_thread::sleep_for(IDLE_WAIT / 10);
+    }
     if (m_dispatcher.joinable()) {
         m_dispatcher.join();
     }
+    if (m_listener.joinable()) {
+        m_listener.join();
+    }
 }
 
 void
 Dispatcher::run()
 {
-    m_running = true;
-    m_logger->info("Starting Dispatcher thread");
+    m_logger->info("Starting Dispatcher thread, batch size {}, look-ahead {}ms{}", m_batchSize, m_lookAhead.count(),
+                   m_legacyScores ? ", reading legacy scores" : "");
 
     while (m_running.load())
     {
         try {
-            auto tx = m_redis->transaction(false,false);
-            auto txRedis = tx.redis();
-
-            txRedis.watch(m_schedulerKey);
-            m_logger->info("watch() returned");
-
-            double minScore = 0;
-            double maxScore = static_cast<double>(time(nullptr));
-            std::vector<std::pair<std::string, double>> zset_result;
-            txRedis.zrangebyscore(m_schedulerKey, sw::redis::BoundedInterval<double>(minScore, maxScore, sw::redis::BoundType::CLOSED), std::back_inserter(zset_result));
-
-            m_logger->info("zrangebyscore() returned");
-            if (!zset_result.empty()) {
-                auto replies = tx.rpush(m_queueKey, zset_result[0].first)
-                                 .zrem(m_schedulerKey, zset_result[0].first)
-                                 .exec();
-                m_logger->info("replies.size()={}", replies.size());
-                //m_logger->info("Dispatcher() moving elt {} to queue", zset_result[0].first);
-                // Expect both steps of transaction to return 1
-                //m_logger->info("Transaction {} {}", replies.get<long long>(0), replies.get<long long>(1));
+            auto now = SchedulerClock::now();
+            bool expired;
+            {
+                // Events still due from a shortened window are taken before fetching the next
+                std::lock_guard<std::mutex> lock(m_mutex);
+                expired = now >= m_windowEnd && (m_local.empty() || m_local.top().m_due > now);
             }
-        } catch (const sw::redis::WatchError &err) {
-            continue;
-        } 
+            if (expired) {
+                fetchWindow(now);
+            }
+            auto due = takeDue(now);
+            if (!due.empty()) {
+                auto moved = confirm(due);
+                m_logger->debug("Dispatcher moved {} of {} events to queue", moved, due.size());
+                if (due.size() == m_batchSize) {
+                    // Backlog: more events may be due already
+                    continue;
+                }
+            }
+            sleep();
+        }
+        // A failed fetch leaves the window unfetched, a failed confirm drops the events taken
         catch (sw::redis::TimeoutError &e) {
             m_logger->error("Dispatcher::run() TimeoutError Exception {}", e.what());
-
+            resetWindow();
             continue;
         }
         catch (const sw::redis::Error &err) {
             m_logger->error("Dispatcher::run() Exception {}", err.what());
+            resetWindow();
+            backoff();
         }
     }
     m_logger->info("Exiting Dispatcher thread");
-}
\ No newline at end of file
+}
+
+void
+Dispatcher::listen()
+{
+    while (m_running.load())
+    {
+        try {
+            auto subscriber = m_redis->subscriber();
+            subscriber.on_message([this](std::string, std::string msg) {
+                // "<score> <event id>"
+                char *end = nullptr;
+                double score = strtod(msg.c_str(), &end);
+                if (end != msg.c_str() && std::isfinite(score) && *end == ' ') {
+                    add({ fromScore(score, m_legacyScores), score, std::string(end + 1) });
+                }
+            });
+            subscriber.subscribe(m_wakeupChannel);
+            // Events published while not subscribed are lost: fetch the window again
+            resetWindow();
+
+            while (m_running.load()) {
+                try {
+                    subscriber.consume();
+                } catch (const sw::redis::TimeoutError &) {
+                    continue;
+                }
+            }
+        }
+        catch (const sw::redis::Error &err) {
+            m_logger->error("Dispatcher::listen() Exception {}", err.what());
+            backoff();
+        }
+    }
+    m_listenerStopped = true;
+}
+
+void
+Dispatcher::add(LocalEvent &&event)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Later events are fetched with their window
+        if (event.m_due >= m_windowEnd) {
+            return;
+        }
+        m_local.push(std::move(event));
+    }
+    m_wakeup.notify_all();
+}
+
+void
+Dispatcher::fetchWindow(SchedulerClock::time_point now)
+{
+    auto windowEnd = now + m_lookAhead;
+    {
+        // Published from here on, events in the window are added as they arrive
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_windowEnd = windowEnd;
+    }
+    // Recorded before the fetch, so an event scheduled into the window meanwhile is published
+    m_windowScript.eval<long long>(*m_redis, { m_windowEndKey }, { std::to_string(toScore(windowEnd)) });
+
+    sw::redis::LimitOptions limit;
+    limit.count = PREFETCH_LIMIT;
+    std::vector<std::pair<std::string, double>> events;
+    std::size_t fetched = 0;
+    auto fetch = [&] (const auto &interval) {
+        m_redis->zrangebyscore(m_schedulerKey, interval, limit, std::back_inserter(events));
+        if (events.size() - fetched == static_cast<std::size_t>(PREFETCH_LIMIT)) {
+            // Later events were left out: end the window at the last one fetched
+            windowEnd = std::min(windowEnd, fromScore(events.back().second, m_legacyScores));
+        }
+        fetched = events.size();
+    };
+    auto windowScore = static_cast<double>(toScore(windowEnd));
+    if (m_legacyScores) {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(windowEnd.time_since_epoch()).count();
+        fetch(sw::redis::RightBoundedInterval<double>(static_cast<double>(seconds), sw::redis::BoundType::CLOSED));
+        fetch(sw::redis::BoundedInterval<double>(LEGACY_SCORE_LIMIT, windowScore, sw::redis::BoundType::CLOSED));
+    } else {
+        fetch(sw::redis::RightBoundedInterval<double>(windowScore, sw::redis::BoundType::CLOSED));
+    }
+
+    {
+        // Events already held are fetched again if still pending, a duplicate is only moved once
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &event: events) {
+            m_local.push({ fromScore(event.second, m_legacyScores), event.second, std::move(event.first) });
+        }
+        m_windowEnd = std::min(m_windowEnd, windowEnd);
+    }
+    m_logger->debug("Dispatcher fetched {} events due within {}ms", events.size(), m_lookAhead.count());
+}
+
+void
+Dispatcher::resetWindow()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_windowEnd = SchedulerClock::time_point();
+    }
+    m_wakeup.notify_all();
+}
+
+std::vector<Dispatcher::LocalEvent>
+Dispatcher::takeDue(SchedulerClock::time_point now)
+{
+    std::vector<LocalEvent> due;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_local.empty() && m_local.top().m_due <= now && due.size() < m_batchSize) {
+        due.push_back(m_local.top());
+        m_local.pop();
+    }
+    return due;
+}
+
+long long
+Dispatcher::confirm(const std::vector<LocalEvent> &events)
+{
+    std::vector<std::string> args;
+    args.reserve(events.size() * 2);
+    for (const auto &event: events) {
+        args.push_back(event.m_id);
+        args.push_back(fmt::format("{}", event.m_score));
+    }
+    return m_confirmScript.eval<long long>(*m_redis, { m_schedulerKey, m_queueKey, m_typesKey }, args);
+}
+
+void
+Dispatcher::sleep()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running.load()) {
+        auto deadline = m_windowEnd;
+        if (!m_local.empty()) {
+            deadline = std::min(deadline, m_local.top().m_due);
+        }
+        if (SchedulerClock::now() >= deadline) {
+            break;
+        }
+        m_wakeup.wait_until(lock, deadline);
+    }
+}
+
+void
+Dispatcher::backoff()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wakeup.wait_for(lock, IDLE_WAIT, [this] { return !m_running.load(); });
+}
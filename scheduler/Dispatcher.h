@@ -1,19 +1,105 @@
 #pragma once
 
+#include "RedisScript.h"
+#include "SchedulerClock.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
 #include <spdlog/spdlog.h>
 #include <sw/redis++/redis++.h>
 #include <thread>
+#include <vector>
 
 
 class Dispatcher {
 public: 
-    Dispatcher(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix);
+    static constexpr std::size_t DEFAULT_BATCH = 100;
+    // Bounded by the arguments a Lua unpack() can pass to a single command
+    static constexpr std::size_t MAX_BATCH = 1000;
+    static constexpr std::chrono::milliseconds DEFAULT_LOOKAHEAD{5000};
+    // Most events fetched per window, the window is shortened to the last one fetched
+    static constexpr long long PREFETCH_LIMIT = 10000;
+    // Delay before retrying after a Redis error
+    static constexpr std::chrono::milliseconds IDLE_WAIT{1000};
+
+    /**
+     * @brief Create a Dispatcher moving due events from the scheduler zset to the queue.  The
+     *        events due within a look-ahead window are fetched at once and fired from a local
+     *        timer; each is then moved only if it was not rescheduled or taken meanwhile.
+     *
+     * @param redis - Redis connection
+     * @param keyPrefix - prefix of the zset, queue and wakeup channel names
+     * @param batchSize - maximum events moved per round trip, clamped to [1, MAX_BATCH]
+     * @param legacyScores - migration mode, also dispatch events scored in seconds (see
+     *                       SchedulerClock.h)
+     * @param lookAhead - length of the window of events fetched at once
+     */
+    Dispatcher(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, std::size_t batchSize = DEFAULT_BATCH,
+               bool legacyScores = false, std::chrono::milliseconds lookAhead = DEFAULT_LOOKAHEAD);
 
     virtual ~Dispatcher();
 
 private:
+    /**
+     * @brief Event held locally until it is due
+     */
+    struct LocalEvent {
+        SchedulerClock::time_point m_due;
+        // Score read from the zset, the event is only moved if it still has it
+        double m_score;
+        std::string m_id;
+
+        bool operator>(const LocalEvent &rhs) const {
+            return m_due > rhs.m_due;
+        }
+    };
+
     void run();
+
+    /**
+     * @brief Receive the events published by Scheduler::scheduleEvent().  Runs on m_listener.
+     */
+    void listen();
+
+    /**
+     * @brief Add a published event to the local timer if it is due within the window
+     */
+    void add(LocalEvent &&event);
+
+    /**
+     * @brief Fetch the events due by the end of a new window into the local timer
+     */
+    void fetchWindow(SchedulerClock::time_point now);
+
+    /**
+     * @brief End the window so that the next pass fetches it again, after events may have
+     *        been missed or dropped from the local timer
+     */
+    void resetWindow();
+
+    /**
+     * @brief Remove up to m_batchSize events due by now from the local timer
+     */
+    std::vector<LocalEvent> takeDue(SchedulerClock::time_point now);
+
+    /**
+     * @brief Atomically move events still scored as fetched from the zset to the queue
+     *
+     * @return long long - number of events moved
+     */
+    long long confirm(const std::vector<LocalEvent> &events);
+
+    /**
+     * @brief Block until the earliest local event or the end of the window is due
+     */
+    void sleep();
+
+    /**
+     * @brief Block for IDLE_WAIT, or until the Dispatcher is stopped
+     */
+    void backoff();
     
     std::shared_ptr<sw::redis::Redis> m_redis;
 
@@ -23,7 +109,40 @@ private:
 
     std::string m_queueKey;
 
+    std::string m_typesKey;
+
+    std::string m_wakeupChannel;
+
+    // Latest window end of any dispatcher, read by producers to decide what to publish
+    std::string m_windowEndKey;
+
+    std::size_t m_batchSize;
+
+    bool m_legacyScores;
+
+    std::chrono::milliseconds m_lookAhead;
+
+    RedisScript m_confirmScript;
+
+    RedisScript m_windowScript;
+
+    // Guards m_local and m_windowEnd
+    std::mutex m_mutex;
+
+    std::condition_variable m_wakeup;
+
+    // Events due within the window, earliest first
+    std::priority_queue<LocalEvent, std::vector<LocalEvent>, std::greater<LocalEvent>> m_local;
+
+    // Events due before it have been fetched into m_local, which is fetched again once it passes
+    SchedulerClock::time_point m_windowEnd;
+
     std::atomic_bool m_running;
 
+    // Set by listen() on exit, the destructor publishes wakeups until then
+    std::atomic_bool m_listenerStopped;
+
     std::thread m_dispatcher;
-};
\ No newline at end of file
+
+    std::thread m_listener;
+};
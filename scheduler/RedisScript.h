@@ -0,0 +1,52 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <sw/redis++/redis++.h>
+#include <vector>
+
+/**
+ * @brief The RedisScript class runs a Lua script by its SHA1, loading it on first use and
+ *        again when the server's script cache was flushed.  Safe to share between threads.
+ */
+class RedisScript {
+public:
+    explicit RedisScript(const char *source): m_source(source)
+    {
+    }
+
+    template<class Result>
+    Result eval(sw::redis::Redis &redis, const std::vector<std::string> &keys, const std::vector<std::string> &args)
+    {
+        std::string loaded;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_sha.empty()) {
+                m_sha = redis.script_load(m_source);
+            }
+            loaded = m_sha;
+        }
+        try {
+            return redis.evalsha<Result>(loaded, keys.begin(), keys.end(), args.begin(), args.end());
+        } catch (const sw::redis::ReplyError &e) {
+            // Script cache flushed (e.g. server restart or failover): load it again and retry once
+            if (std::string(e.what()).find("NOSCRIPT") == std::string::npos) {
+                throw;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // Another thread may have reloaded it already
+                if (m_sha == loaded) {
+                    m_sha = redis.script_load(m_source);
+                }
+                loaded = m_sha;
+            }
+            return redis.evalsha<Result>(loaded, keys.begin(), keys.end(), args.begin(), args.end());
+        }
+    }
+
+private:
+    const char *m_source;
+    std::mutex m_mutex;
+    std::string m_sha;
+};
@@ -1,20 +1,47 @@
 #include "Scheduler.h"
 
-
-Scheduler::Scheduler(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, bool dispatcher, bool worker):
+/**
+ * @brief Add an event to the scheduler zset, recording its type, and publish it on the wakeup
+ *        channel if it is due before the previous head or within the latest window a dispatcher
+ *        has fetched, so they add it to their local timer.  Legacy scores are left out of the
+ *        comparison, since they sort first whenever they are due.
+ *        KEYS[1] - scheduler zset, KEYS[2] - types hash, KEYS[3] - window end key
+ *        ARGV[1] - score, ARGV[2] - event id, ARGV[3] - wakeup channel, ARGV[4] - lowest
+ *        millisecond score, ARGV[5] - type
+ *        Returns 1 if the event was published
+ */
+static const char *SCHEDULE_SCRIPT = R"lua(
+local head = redis.call('ZRANGEBYSCORE', KEYS[1], ARGV[4], '+inf', 'WITHSCORES', 'LIMIT', 0, 1)
+redis.call('ZADD', KEYS[1], ARGV[1], ARGV[2])
+redis.call('HSET', KEYS[2], ARGV[2], ARGV[5])
+local score = tonumber(ARGV[1])
+local windowEnd = tonumber(redis.call('GET', KEYS[3]) or '0')
+if #head == 0 or score < tonumber(head[2]) or score <= windowEnd then
+    redis.call('PUBLISH', ARGV[3], ARGV[1] .. ' ' .. ARGV[2])
+    return 1
+end
+return 0
+)lua";Scheduler::Scheduler(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, bool dispatcher, bool worker,
+                     std::size_t batchSize, bool legacyScores, std::chrono::milliseconds lookAhead,
+                     WorkerPool::Handlers handlers, std::size_t workerThreads, bool pinWorkers):
     m_redis(redis),
     m_logger(spdlog::get("scheduler")),
     m_schedulerKey(keyPrefix+"Zset"),
     m_queueKey(keyPrefix+"Queue"),
+    m_typesKey(keyPrefix+"Types"),
+    m_wakeupChannel(keyPrefix+"Wakeup"),
+    m_windowEndKey(keyPrefix+"WindowEnd"),
+    m_scheduleScript(SCHEDULE_SCRIPT),
     m_running(false),
     m_dispatcher(nullptr),
     m_worker(nullptr)
 {
     if (dispatcher) {
-        m_dispatcher = std::make_unique<Dispatcher>(redis, keyPrefix);
+        m_dispatcher = std::make_unique<Dispatcher>(redis, keyPrefix, batchSize, legacyScores, lookAhead);
     }
     if (worker) {
-        m_worker = std::make_unique<Worker>(redis, keyPrefix);
+        m_worker = std::make_unique<WorkerPool>(redis, keyPrefix, std::move(handlers), workerThreads,
+                                                WorkerPool::DEFAULT_DEQUEUERS, pinWorkers);
     }
 }
 
@@ -23,19 +50,31 @@ Scheduler::~Scheduler()
     m_running = false;
 }
 
-void Scheduler::scheduleEvent(const std::string &eventId, uint32_t , uint32_t interval)
+void Scheduler::scheduleEvent(const std::string &eventId, uint32_t type, SchedulerClock::time_point due)
 {
-    time_t now = time(nullptr);
-    now += interval;
-    double score = static_cast<double>(now + interval);
+    auto score = toScore(due);
+    auto now = SchedulerClock::now();
 
     try {
-        m_logger->info("Now {} Scheduling event {} for time {}", now, eventId, score);
-        m_redis->zadd(m_schedulerKey, eventId, score);
+        m_logger->info("Now {} Scheduling event {} of type {} for time {}", toScore(now), eventId, type, score);
+        m_scheduleScript.eval<long long>(*m_redis, { m_schedulerKey, m_typesKey, m_windowEndKey },
+                                         { std::to_string(score), eventId, m_wakeupChannel,
+                                           std::to_string(static_cast<long long>(LEGACY_SCORE_LIMIT)),
+                                           std::to_string(type) });
     }
     catch (std::exception &e) {
         m_logger->error("scheduleEvent() caught {}", e.what());
     }
 }
 
+void Scheduler::scheduleEvent(const std::string &eventId, uint32_t type, SchedulerClock::duration delay)
+{
+    scheduleEvent(eventId, type, SchedulerClock::now() + delay);
+}
 
+void Scheduler::registerHandler(uint32_t type, WorkerPool::Handler handler)
+{
+    if (m_worker) {
+        m_worker->registerHandler(type, std::move(handler));
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Dispatcher.h"
-#include "Worker.h"
+#include "RedisScript.h"
+#include "SchedulerClock.h"
+#include "WorkerPool.h"
 #include <atomic>
 #include <memory>
 #include <spdlog/spdlog.h>
@@ -10,11 +12,32 @@
 
 class Scheduler {
 public:
-    Scheduler(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, bool dispatcher = true, bool worker = true);
+    Scheduler(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, bool dispatcher = true, bool worker = true,
+              std::size_t batchSize = Dispatcher::DEFAULT_BATCH, bool legacyScores = false,
+              std::chrono::milliseconds lookAhead = Dispatcher::DEFAULT_LOOKAHEAD, WorkerPool::Handlers handlers = {},
+              std::size_t workerThreads = 0, bool pinWorkers = false);
 
     virtual ~Scheduler();
 
-    void scheduleEvent(const std::string &eventId, uint32_t type, uint32_t interval);
+    /**
+     * @brief Add an event to the scheduler zset, publishing it to the dispatchers if it is due
+     *        soon.  The due time is kept to the millisecond.
+     *
+     * @param eventId - event id, rescheduling an event already in the zset moves it
+     * @param type - event type, selects the WorkerPool handler
+     * @param due - time the event is due
+     */
+    void scheduleEvent(const std::string &eventId, uint32_t type, SchedulerClock::time_point due);
+
+    /**
+     * @brief Add an event due after a delay from now, see above
+     */
+    void scheduleEvent(const std::string &eventId, uint32_t type, SchedulerClock::duration delay);
+
+    /**
+     * @brief Register the handler of an event type with the WorkerPool, if there is one
+     */
+    void registerHandler(uint32_t type, WorkerPool::Handler handler);
 
 private:
     std::shared_ptr<sw::redis::Redis> m_redis;
@@ -25,9 +48,18 @@ private:
 
     std::string m_queueKey;
 
+    std::string m_typesKey;
+
+    std::string m_wakeupChannel;
+
+    // Latest window end of any dispatcher, see Dispatcher::fetchWindow()
+    std::string m_windowEndKey;
+
+    RedisScript m_scheduleScript;
+
     std::atomic_bool m_running;
 
     std::unique_ptr<Dispatcher> m_dispatcher;
 
-    std::unique_ptr<Worker> m_worker;
+    std::unique_ptr<WorkerPool> m_worker;
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief Events are scored in the scheduler zset by their due time in milliseconds since the
+ *        epoch of SchedulerClock.  Earlier versions scored them in whole seconds: such legacy
+ *        scores are all below LEGACY_SCORE_LIMIT (1e11 seconds is beyond the year 5000, 1e11
+ *        milliseconds is in 1973), so both kinds can be told apart in one zset.
+ */
+using SchedulerClock = std::chrono::system_clock;
+
+constexpr double LEGACY_SCORE_LIMIT = 1e11;
+
+/**
+ * @brief Return the score of a due time, in milliseconds since the epoch
+ */
+inline long long toScore(SchedulerClock::time_point due)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(due.time_since_epoch()).count();
+}
+
+/**
+ * @brief Return the due time of a score
+ *
+ * @param score - score read from the zset
+ * @param legacy - read scores below LEGACY_SCORE_LIMIT as seconds
+ */
+inline SchedulerClock::time_point fromScore(double score, bool legacy = false)
+{
+    if (legacy && score < LEGACY_SCORE_LIMIT) {
+        score *= 1000;
+    }
+    // Keep far-off scores within the range of the clock's nanosecond time points
+    auto ms = std::chrono::milliseconds(static_cast<long long>(std::min(std::max(score, 0.0), 1e15)));
+    return SchedulerClock::time_point(std::chrono::duration_cast<SchedulerClock::duration>(ms));
+}
@@ -0,0 +1,206 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * @brief Pop up to a number of events from the head of the queue
+ *        KEYS[1] - queue
+ *        ARGV[1] - maximum events to pop
+ *        Returns the events popped
+ */
+static const char *POP_SCRIPT = R"lua(
+local items = redis.call('LRANGE', KEYS[1], 0, tonumber(ARGV[1]) - 1)
+if #items > 0 then
+    redis.call('LTRIM', KEYS[1], #items, -1)
+end
+return items
+)lua";
+
+Event Event::parse(const std::string &item)
+{
+    Event event;
+    char *end = nullptr;
+    auto type = strtoul(item.c_str(), &end, 10);
+    if (end != item.c_str() && *end == ' ' && type <= UINT32_MAX) {
+        event.m_type = static_cast<uint32_t>(type);
+        event.m_id = std::string(end + 1);
+    } else {
+        event.m_id = item;
+    }
+    return event;
+}
+
+std::string Event::format() const
+{
+    return std::to_string(m_type) + " " + m_id;
+}
+
+WorkerPool::WorkerPool(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, Handlers handlers,
+                       std::size_t executors, std::size_t dequeuers, bool pin):
+    m_redis(redis),
+    m_logger(spdlog::get("scheduler")),
+    m_queueKey(keyPrefix+"Queue"),
+    m_pin(pin),
+    m_popScript(POP_SCRIPT),
+    m_capacity(2 * DEQUEUE_BATCH * std::max<std::size_t>(dequeuers, 1)),
+    m_running(true)
+{
+    for (auto &handler: handlers) {
+        m_handlers[handler.first] = std::make_shared<const Handler>(std::move(handler.second));
+    }
+    std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    if (executors == 0) {
+        executors = cores;
+    }
+    m_logger->info("Starting WorkerPool, {} executors{}, {} dequeuers", executors, m_pin ? " pinned to cores" : "",
+                   std::max<std::size_t>(dequeuers, 1));
+    for (std::size_t i = 0; i < executors; i++) {
+        m_executors.emplace_back(&WorkerPool::execute, this, i % cores);
+    }
+    for (std::size_t i = 0; i < std::max<std::size_t>(dequeuers, 1); i++) {
+        m_dequeuers.emplace_back(&WorkerPool::dequeue, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_ready.notify_all();
+    m_room.notify_all();
+    for (auto &thread: m_dequeuers) {
+        thread.join();
+    }
+    for (auto &thread: m_executors) {
+        thread.join();
+    }
+    if (!m_events.empty()) {
+        // Hand back the events taken but not handled, in their order at the head of the queue
+        std::vector<std::string> items;
+        for (auto event = m_events.rbegin(); event != m_events.rend(); ++event) {
+            items.push_back(event->format());
+        }
+        try {
+            m_redis->lpush(m_queueKey, items.begin(), items.end());
+            m_logger->info("WorkerPool returned {} unhandled events to the queue", items.size());
+        } catch (std::exception &e) {
+            m_logger->error("WorkerPool lost {} unhandled events: {}", items.size(), e.what());
+        }
+    }
+    m_logger->info("Exiting WorkerPool");
+}
+
+void WorkerPool::registerHandler(uint32_t type, Handler handler)
+{
+    auto shared = std::make_shared<const Handler>(std::move(handler));
+    std::unique_lock<std::shared_mutex> lock(m_handlersMutex);
+    m_handlers[type] = std::move(shared);
+}
+
+void WorkerPool::dequeue()
+{
+    while (m_running.load()) {
+        try {
+            std::size_t room;
+            {
+                // Leave events in Redis, for other workers, while the executors are behind
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_room.wait(lock, [&] { return m_events.size() < m_capacity || !m_running.load(); });
+                if (!m_running.load()) {
+                    break;
+                }
+                room = m_capacity - m_events.size();
+            }
+            auto item = m_redis->blpop(m_queueKey, std::chrono::seconds(2));
+            if (!item) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_events.push_back(Event::parse(item->second));
+            }
+            m_ready.notify_one();
+
+            // Take whatever else is already queued in one more round trip
+            auto more = std::min(room, DEQUEUE_BATCH) - 1;
+            if (more) {
+                auto items = m_popScript.eval<std::vector<std::string>>(*m_redis, { m_queueKey }, { std::to_string(more) });
+                if (!items.empty()) {
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        for (const auto &i: items) {
+                            m_events.push_back(Event::parse(i));
+                        }
+                    }
+                    m_ready.notify_all();
+                }
+            }
+        }
+        catch (sw::redis::TimeoutError &e) {
+            continue;
+        }
+        catch (std::exception &e) {
+            m_logger->error("WorkerPool::dequeue() caught exception {}", e.what());
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_room.wait_for(lock, std::chrono::seconds(1), [&] { return !m_running.load(); });
+        }
+    }
+}
+
+void WorkerPool::execute(std::size_t core)
+{
+#ifdef __linux__
+    if (m_pin) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            m_logger->warn("Unable to pin executor to core {}", core);
+        }
+    }
+#else
+    (void)core;
+#endif
+    while (true) {
+        Event event;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [&] { return !m_events.empty() || !m_running.load(); });
+            if (!m_running.load()) {
+                return;
+            }
+            event = std::move(m_events.front());
+            m_events.pop_front();
+        }
+        m_room.notify_one();
+        handle(event);
+    }
+}
+
+void WorkerPool::handle(const Event &event)
+{
+    std::shared_ptr<const Handler> handler;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_handlersMutex);
+        auto found = m_handlers.find(event.m_type);
+        if (found != m_handlers.end()) {
+            handler = found->second;
+        }
+    }
+    if (!handler) {
+        m_logger->warn("No handler for event {} of type {}, dropped", event.m_id, event.m_type);
+        return;
+    }
+    try {
+        (*handler)(event);
+    }
+    catch (std::exception &e) {
+        m_logger->error("Handler of event {} of type {} caught exception {}", event.m_id, event.m_type, e.what());
+    }
+}
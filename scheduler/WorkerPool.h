@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RedisScript.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <spdlog/spdlog.h>
+#include <sw/redis++/redis++.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Event taken from the queue, held as "<type> <event id>"
+ */
+struct Event {
+    uint32_t m_type = 0;
+    std::string m_id;
+
+    /**
+     * @brief Parse a queue item, an item without a type (queued by earlier versions) is type 0
+     */
+    static Event parse(const std::string &item);
+
+    std::string format() const;
+};
+
+/**
+ * @brief The WorkerPool class handles the events moved to the queue by the dispatchers.
+ *        Dequeuer threads take events from Redis in batches onto a bounded local queue, which
+ *        executor threads drain by calling the handler registered for each event type, so a
+ *        slow handler never holds up dequeuing.  Events still on the local queue when the
+ *        pool is destroyed are pushed back to the head of the Redis queue.
+ */
+class WorkerPool {
+public:
+    using Handler = std::function<void(const Event &)>;
+    using Handlers = std::unordered_map<uint32_t, Handler>;
+
+    static constexpr std::size_t DEFAULT_DEQUEUERS = 1;
+    // Most events taken from Redis per round trip
+    static constexpr std::size_t DEQUEUE_BATCH = 100;
+
+    /**
+     * @brief Create a WorkerPool
+     *
+     * @param redis - Redis connection, needs a connection per dequeuer for their blocking pops
+     * @param keyPrefix - prefix of the queue name
+     * @param handlers - handlers by event type, registered before any event is taken
+     * @param executors - number of executor threads, one per hardware thread if 0
+     * @param dequeuers - number of dequeuer threads
+     * @param pin - pin executor i to core i modulo the number of cores
+     */
+    WorkerPool(std::shared_ptr<sw::redis::Redis> redis, const std::string &keyPrefix, Handlers handlers,
+               std::size_t executors = 0, std::size_t dequeuers = DEFAULT_DEQUEUERS, bool pin = false);
+
+    virtual ~WorkerPool();
+
+    /**
+     * @brief Register the handler of an event type, replacing any previous one.  Events of
+     *        types without a handler are logged and dropped.
+     */
+    void registerHandler(uint32_t type, Handler handler);
+
+private:
+    void dequeue();
+
+    void execute(std::size_t executor);
+
+    void handle(const Event &event);
+
+    std::shared_ptr<sw::redis::Redis> m_redis;
+
+    std::shared_ptr<spdlog::logger> m_logger;
+
+    std::string m_queueKey;
+
+    bool m_pin;
+
+    RedisScript m_popScript;
+
+    std::shared_mutex m_handlersMutex;
+
+    // Handlers are shared so executors run them without holding m_handlersMutex
+    std::unordered_map<uint32_t, std::shared_ptr<const Handler>> m_handlers;
+
+    // Guards m_events
+    std::mutex m_mutex;
+
+    // Signalled when events are added, for the executors
+    std::condition_variable m_ready;
+
+    // Signalled when events are taken, for the dequeuers
+    std::condition_variable m_room;
+
+    std::deque<Event> m_events;
+
+    std::size_t m_capacity;
+
+    std::atomic_bool m_running;
+
+    std::vector<std::thread> m_executors;
+
+    std::vector<std::thread> m_dequeuers;
+};
@@ -16,7 +16,7 @@ std::atomic_bool running = true;
 
 void usage() {
     std::cerr << "Usage\n"
-              << "scheduler [-h <redisHost> ][-p <redisPort>][-e <redisAuthEnvVar>][-n <name> ][-l <logLevel>][-d][-w]\n";
+              << "scheduler [-h <redisHost> ][-p <redisPort>][-e <redisAuthEnvVar>][-n <name> ][-l <logLevel>][-b <batchSize>][-a <lookAheadMs>][-m][-d][-w][-t <workerThreads>][-C]\n";
 
 }
 
@@ -40,9 +40,14 @@ int main(int argc, char**argv)
     std::string name = "client1";
     bool dispatcher = false;
     bool worker = false;
+    std::size_t batchSize = Dispatcher::DEFAULT_BATCH;
+    bool legacyScores = false;
+    auto lookAhead = Dispatcher::DEFAULT_LOOKAHEAD;
+    std::size_t workerThreads = 0;
+    bool pinWorkers = false;
     int c;
 
-    while ((c = getopt(argc,argv, "h:p:e:l:n:s:c:dw?")) != EOF) {
+    while ((c = getopt(argc,argv, "h:p:e:l:n:s:c:b:a:t:mdwC?")) != EOF) {
         switch (c) {
             case 'h':
                 redisHost = optarg;
@@ -63,12 +68,27 @@ int main(int argc, char**argv)
             case 'n':
                 name = optarg;
                 break;
+            case 'b':
+                batchSize = static_cast<std::size_t>(std::stoul(optarg));
+                break;
+            case 'a':
+                lookAhead = std::chrono::milliseconds(std::stoll(optarg));
+                break;
+            case 'm':
+                legacyScores = true;
+                break;
             case 'd':
                 dispatcher = true;
                 break;
             case 'w':
                 worker = true;
                 break;
+            case 't':
+                workerThreads = static_cast<std::size_t>(std::stoul(optarg));
+                break;
+            case 'C':
+                pinWorkers = true;
+                break;
             case 'l':
                 logLevel = std::stoi(optarg);
                 break;
@@ -130,14 +150,20 @@ int main(int argc, char**argv)
         }
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        Scheduler scheduler(redis,"scheduler",dispatcher,worker);
+        WorkerPool::Handlers handlers;
+        for (uint32_t type = 0; type < 2; type++) {
+            handlers[type] = [logger, type](const Event &event) {
+                logger->info("Now {} worker thread handling event {} of type {}", toScore(SchedulerClock::now()), event.m_id, type);
+            };
+        }
+        Scheduler scheduler(redis,"scheduler",dispatcher,worker,batchSize,legacyScores,lookAhead,handlers,workerThreads,pinWorkers);
 
         uint32_t eventCount = 0; 
 
         for (eventCount = 0; eventCount < 10; eventCount++) {
 
             auto eventId = fmt::format("{}-event-{}",name,eventCount);
-            scheduler.scheduleEvent(eventId,0,10);
+            scheduler.scheduleEvent(eventId,eventCount % 2,std::chrono::seconds(10));
 
             std::this_thread::sleep_for(std::chrono::seconds(1));
         }
@@ -0,0 +1,135 @@
+#include <spdlog/spdlog.h>
+#include "asyncstore.h"
+
+AsyncStore::AsyncStore(std::shared_ptr<sw::redis::AsyncRedis> redis, std::shared_ptr<spdlog::logger> logger,
+                       std::shared_ptr<EntryCache> cache, std::shared_ptr<KeyTracker> tracker,
+                       std::shared_ptr<EntryPool> pool):
+    m_redis(redis), m_logger(logger), m_cache(cache), m_tracker(tracker), m_pool(pool)
+{
+
+}
+
+void AsyncStore::storeEntry(const std::string &key, const Entry &entry, ResultCallback callback)
+{
+    // The copy becomes the cached snapshot once stored
+    auto snapshot = makeEntry(m_pool, entry);
+    auto dirty = snapshot->dirty();
+    if (!dirty) {
+        callback(true);
+        return;
+    }
+    std::vector<std::pair<sw::redis::StringView, sw::redis::StringView>> fields;
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (dirty & (RecordMask(1) << idx)) {
+            fields.emplace_back(Entry::name(idx), sw::redis::StringView(snapshot->data(idx), snapshot->size(idx)));
+        }
+    }
+    auto writeStamp = stamp(key);
+    // Completions may outlive this AsyncStore, so they hold their own references
+    auto cache = m_cache;
+    auto logger = m_logger;
+    try {
+        m_redis->hmset(key, fields.begin(), fields.end(),
+            [key, snapshot, dirty, writeStamp, cache, logger, callback] (sw::redis::Future<void> &&fut) {
+                bool stored = false;
+                try {
+                    fut.get();
+                    snapshot->clean();
+                    // Records not written may differ from what is stored
+                    snapshot->unload(~dirty);
+                    cache->put(key, snapshot, writeStamp);
+                    logger->info("Stored entry {}", key);
+                    stored = true;
+                } catch (const sw::redis::Error &e) {
+                    logger->error("Caught Redis exception {}", e.what());
+                }
+                callback(stored);
+            });
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+        callback(false);
+    }
+}
+
+std::future<bool> AsyncStore::storeEntry(const std::string &key, const Entry &entry)
+{
+    auto promise = std::make_shared<std::promise<bool>>();
+    storeEntry(key, entry, [promise] (bool stored) { promise->set_value(stored); });
+    return promise->get_future();
+}
+
+void AsyncStore::queryEntry(const std::string &key, EntryCallback callback)
+{
+    uint64_t readStamp = 0;
+    auto cached = m_cache->find(key, &readStamp);
+    if (cached && cached->loaded() == Entry::ALL_RECORDS && m_tracker && m_tracker->valid(key, readStamp)) {
+        callback(cached);
+        return;
+    }
+    readStamp = stamp(key);
+    auto cache = m_cache;
+    auto logger = m_logger;
+    auto pool = m_pool;
+    try {
+        m_redis->hgetall<std::unordered_map<std::string, std::string>>(key,
+            [key, readStamp, cache, logger, pool, callback]
+            (sw::redis::Future<std::unordered_map<std::string, std::string>> &&fut) {
+                EntryHandle entry;
+                try {
+                    auto fields = fut.get();
+                    entry = makeEntry(pool, key, fields);
+                    cache->put(key, entry, readStamp);
+                } catch (const sw::redis::Error &e) {
+                    logger->error("Caught Redis exception {}", e.what());
+                } catch (std::exception &e) {
+                    logger->error("Caught std::exception {}", e.what());
+                }
+                callback(entry);
+            });
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+        callback(nullptr);
+    }
+}
+
+std::future<EntryHandle> AsyncStore::queryEntry(const std::string &key)
+{
+    auto promise = std::make_shared<std::promise<EntryHandle>>();
+    queryEntry(key, [promise] (EntryHandle entry) { promise->set_value(entry); });
+    return promise->get_future();
+}
+
+void AsyncStore::deleteEntry(const std::string &key, ResultCallback callback)
+{
+    auto cache = m_cache;
+    auto logger = m_logger;
+    try {
+        m_redis->unlink(key, [key, cache, logger, callback] (sw::redis::Future<long long> &&fut) {
+            bool removed = false;
+            try {
+                fut.get();
+                cache->erase(key);
+                logger->info("Removed entry {}", key);
+                removed = true;
+            } catch (const sw::redis::Error &e) {
+                logger->error("Caught Redis exception {}", e.what());
+            }
+            callback(removed);
+        });
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+        callback(false);
+    }
+}
+
+std::future<bool> AsyncStore::deleteEntry(const std::string &key)
+{
+    auto promise = std::make_shared<std::promise<bool>>();
+    deleteEntry(key, [promise] (bool removed) { promise->set_value(removed); });
+    return promise->get_future();
+}
+
+uint64_t AsyncStore::stamp(const std::string &key) const
+{
+    return m_tracker ? m_tracker->stamp(key) : 0;
+}
@@ -0,0 +1,90 @@
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <sw/redis++/async_redis++.h>
+#include "entry.h"
+#include "entrycache.h"
+#include "entrypool.h"
+#include "keytracker.h"
+
+#pragma once
+
+namespace spdlog {
+    class logger;
+}
+
+/**
+ * @brief The AsyncStore class is the non-blocking counterpart of Store, issuing its commands
+ *        on a sw::redis::AsyncRedis event loop and completing through callbacks or futures.
+ *        It shares the entry cache (and key tracker) of a Store, so entries read or written
+ *        by either are visible to both.
+ *
+ *        Callbacks run on the AsyncRedis event loop thread, or on the calling thread when a
+ *        query is answered from the cache, and must not block or throw.
+ */
+class AsyncStore {
+public:
+    // Called with true if the command succeeded
+    using ResultCallback = std::function<void(bool)>;
+
+    // Called with the entry read, or nullptr if it could not be read
+    using EntryCallback = std::function<void(EntryHandle)>;
+
+    /**
+     * @brief Construct a new AsyncStore object
+     *
+     * @param redis - asynchronous Redis connection
+     * @param logger - logger
+     * @param cache - entry cache, usually Store::cache()
+     * @param tracker - key tracker, usually Store::tracker(), nullptr to always read from Redis
+     * @param pool - entry pool, usually Store::pool(), nullptr to allocate entries on the heap
+     */
+    AsyncStore(std::shared_ptr<sw::redis::AsyncRedis> redis, std::shared_ptr<spdlog::logger> logger,
+               std::shared_ptr<EntryCache> cache, std::shared_ptr<KeyTracker> tracker = nullptr,
+               std::shared_ptr<EntryPool> pool = nullptr);
+
+    ~AsyncStore() = default;
+
+    /**
+     * @brief Store the dirty records of an entry, see Store::storeEntry().  The entry is
+     *        copied, it can be reused as soon as this returns.
+     *
+     * @param key - Redis key
+     * @param entry - entry to store
+     * @param callback - completion callback
+     */
+    void storeEntry(const std::string &key, const Entry &entry, ResultCallback callback);
+
+    std::future<bool> storeEntry(const std::string &key, const Entry &entry);
+
+    /**
+     * @brief Read every record of an entry, answering from the cache when tracking shows the
+     *        copy is current and holds them all
+     *
+     * @param key - Redis key
+     * @param callback - completion callback
+     */
+    void queryEntry(const std::string &key, EntryCallback callback);
+
+    std::future<EntryHandle> queryEntry(const std::string &key);
+
+    /**
+     * @brief Remove an entry
+     *
+     * @param key - Redis key
+     * @param callback - completion callback
+     */
+    void deleteEntry(const std::string &key, ResultCallback callback);
+
+    std::future<bool> deleteEntry(const std::string &key);
+
+private:
+    uint64_t stamp(const std::string &key) const;
+
+    std::shared_ptr<sw::redis::AsyncRedis> m_redis;
+    std::shared_ptr<spdlog::logger> m_logger;
+    std::shared_ptr<EntryCache> m_cache;
+    std::shared_ptr<KeyTracker> m_tracker;
+    std::shared_ptr<EntryPool> m_pool;
+};
@@ -1,49 +1,234 @@
 #include "entry.h"
 #include <spdlog/spdlog.h>
 
-Entry::Entry(const std::string &key): m_key(key)
+template<class... Records>
+const char *BasicEntry<Records...>::name(std::size_t idx)
 {
+    static const char *names[] = { Records::NAME... };
+    return idx < RECORDS ? names[idx] : nullptr;
+}
 
+template<class... Records>
+std::size_t BasicEntry<Records...>::capacity(std::size_t idx)
+{
+    static const std::size_t capacities[] = { Records::CAPACITY... };
+    return idx < RECORDS ? capacities[idx] : 0;
 }
 
-Entry::Entry(const std::string &key, std::unordered_map<std::string, std::string> &data): m_key(key), 
-    m_record1(data["record1"].data(), data["record1"].size())
+template<class... Records>
+BasicEntry<Records...>::BasicEntry(const std::string &key): m_key(key)
 {
 
 }
 
-void Entry::refresh(std::unordered_map<std::string, std::string> &data)
+template<class... Records>
+BasicEntry<Records...>::BasicEntry(const std::string &key, std::unordered_map<std::string, std::string> &data): m_key(key)
 {
-    m_record1.refresh(data["record1"].data(), data["record1"].size());
+    refresh(data);
 }
 
-
-
-const char *Entry::data(int idx) {
-    switch(idx) {
-    case 0:
-        return m_record1.data();
-    default:
-        return nullptr;
+template<class... Records>
+void BasicEntry<Records...>::refresh(std::unordered_map<std::string, std::string> &data)
+{
+    for (std::size_t idx = 0; idx < RECORDS; idx++) {
+        auto field = data.find(name(idx));
+        refresh(idx, field != data.end() ? std::move(field->second) : std::string());
     }
 }
 
-size_t Entry::size(int idx) const {
-    switch(idx) {
-    case 0:
-        return m_record1.container_size();
-    default:
-        return 0;
+template<class... Records>
+void BasicEntry<Records...>::refresh(std::size_t idx, std::string &&data)
+{
+    if (data.empty()) {
+        refresh(idx, nullptr, 0);
+        return;
     }
+    // Take ownership of the reply buffer and serve reads from it directly
+    auto buffer = std::make_shared<const std::string>(std::move(data));
+    refresh(idx, std::shared_ptr<const char>(buffer, buffer->data()), buffer->size());
+}
+
+template<class... Records>
+void BasicEntry<Records...>::refresh(std::size_t idx, std::shared_ptr<const char> buffer, std::size_t size)
+{
+    forEachRecord([&] (std::size_t i, auto &state) {
+        if (i != idx) {
+            return;
+        }
+        using View = decltype(state.m_view);
+        if (size == 0) {
+            state.m_fields.clear();
+            state.m_fields.clean();
+            state.m_view = View();
+            state.m_buffer.reset();
+        } else {
+            // Build the view first, the record is left as it was if the buffer is invalid
+            View view(buffer.get(), size);
+            state.m_view = view;
+            state.m_buffer = std::move(buffer);
+        }
+        state.m_loaded = true;
+        state.m_stored = true;
+    });
+}
+
+template<class... Records>
+void BasicEntry<Records...>::unload(RecordMask records)
+{
+    forEachRecord([&] (std::size_t idx, auto &state) {
+        if (records & (RecordMask(1) << idx)) {
+            using View = decltype(state.m_view);
+            state.m_fields.clear();
+            state.m_view = View();
+            state.m_buffer.reset();
+            state.m_wire.clear();
+            state.m_loaded = false;
+        }
+    });
+}
+
+template<class... Records>
+RecordMask BasicEntry<Records...>::loaded() const
+{
+    RecordMask records = 0;
+    forEachRecord([&] (std::size_t idx, const auto &state) {
+        if (state.m_loaded) {
+            records |= RecordMask(1) << idx;
+        }
+    });
+    return records;
+}
+
+template<class... Records>
+RecordMask BasicEntry<Records...>::dirty() const
+{
+    RecordMask records = 0;
+    forEachRecord([&] (std::size_t idx, const auto &state) {
+        if (!state.m_loaded) {
+            return;
+        }
+        // A record still held as a view has not been modified since it was read
+        if (!state.m_stored ||
+            (!state.m_buffer && (state.m_fields.reshaped() || state.m_fields.dirty().any()))) {
+            records |= RecordMask(1) << idx;
+        }
+    });
+    return records;
+}
+
+template<class... Records>
+bool BasicEntry<Records...>::patchable(std::size_t idx) const
+{
+    bool patchable = false;
+    forEachRecord([&] (std::size_t i, const auto &state) {
+        if (i == idx) {
+            patchable = state.m_loaded && state.m_stored && !state.m_buffer &&
+                        !state.m_fields.reshaped() && state.m_fields.dirty().any();
+        }
+    });
+    return patchable;
+}
+
+template<class... Records>
+uint32_t BasicEntry<Records...>::keysHash(std::size_t idx) const
+{
+    uint32_t hash = 0;
+    forEachRecord([&] (std::size_t i, const auto &state) {
+        if (i == idx) {
+            hash = state.m_fields.keys_hash();
+        }
+    });
+    return hash;
+}
+
+template<class... Records>
+void BasicEntry<Records...>::forEachDirtyRange(std::size_t idx,
+    const std::function<void(std::size_t, const char*, std::size_t)> &patch) const
+{
+    forEachRecord([&] (std::size_t i, const auto &state) {
+        if (i == idx && !state.m_buffer) {
+            state.m_fields.for_each_dirty_range(patch);
+        }
+    });
+}
+
+template<class... Records>
+void BasicEntry<Records...>::clean()
+{
+    forEachRecord([] (std::size_t, auto &state) {
+        if (state.m_loaded) {
+            state.m_stored = true;
+            if (!state.m_buffer) {
+                state.m_fields.clean();
+            }
+        }
+    });
 }
 
-void Entry::dump(std::shared_ptr<spdlog::logger> logger)
+template<class... Records>
+const char *BasicEntry<Records...>::data(std::size_t idx)
+{
+    const char *data = nullptr;
+    forEachRecord([&] (std::size_t i, auto &state) {
+        if (i != idx || !state.m_loaded) {
+            return;
+        }
+        // A view already holding the compact form is sent back as received
+        if (state.m_buffer && state.m_view.container_size() == state.m_view.serialized_size()) {
+            data = state.m_view.data();
+            return;
+        }
+        if (state.m_buffer) {
+            state.m_view.serialize(state.m_wire);
+        } else {
+            state.m_fields.serialize(state.m_wire);
+        }
+        data = state.m_wire.data();
+    });
+    return data;
+}
+
+template<class... Records>
+size_t BasicEntry<Records...>::size(std::size_t idx) const
+{
+    size_t size = 0;
+    forEachRecord([&] (std::size_t i, const auto &state) {
+        if (i == idx && state.m_loaded) {
+            size = state.m_buffer ? state.m_view.serialized_size() : state.m_fields.serialized_size();
+        }
+    });
+    return size;
+}
+
+template<class... Records>
+size_t BasicEntry<Records...>::footprint() const
+{
+    size_t bytes = sizeof(BasicEntry) + m_key.capacity();
+    forEachRecord([&] (std::size_t, const auto &state) {
+        bytes += state.m_wire.capacity();
+        if (state.m_buffer) {
+            bytes += sizeof(std::string) + state.m_view.container_size();
+        }
+    });
+    return bytes;
+}
+
+template<class... Records>
+void BasicEntry<Records...>::dump(std::shared_ptr<spdlog::logger> logger) const
 {
     logger->info("Entry Key: {}", m_key);
-    for (const auto &elt: m_record1)
-    {
-        auto v = m_record1.at(elt);
-        logger->info("  {}: {}", elt.m_key, v.m_value);
-    }
+    forEachRecord([&] (std::size_t idx, const auto &state) {
+        if (!state.m_loaded) {
+            return;
+        }
+        logger->info(" {}:", name(idx));
+        using View = decltype(state.m_view);
+        auto record = state.m_buffer ? state.m_view : View(state.m_fields.data(), state.m_fields.container_size());
+        for (const auto &elt: record) {
+            auto v = record.at(elt);
+            logger->info("  {}: {}", elt.m_key, v.m_value);
+        }
+    });
 }
 
+template class BasicEntry<Record1, Record2>;
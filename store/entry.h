@@ -1,5 +1,11 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include "flatdict.h"
 
@@ -22,33 +28,270 @@ struct Value
     }
 };
 
-using Fields = dict::Dict<Value,20>;
+/**
+ * @brief Record tags: each names the Redis hash field a record is stored in and the Dict
+ *        holding it
+ */
+struct Record1 {
+    static constexpr const char *NAME = "record1";
+    static constexpr std::size_t CAPACITY = 20;
+    using Fields = dict::Dict<Value,CAPACITY>;
+    using View = dict::DictView<Value,CAPACITY>;
+};
+
+struct Record2 {
+    static constexpr const char *NAME = "record2";
+    static constexpr std::size_t CAPACITY = 8;
+    using Fields = dict::Dict<Value,CAPACITY>;
+    using View = dict::DictView<Value,CAPACITY>;
+};
+
+using Fields = Record1::Fields;
+
+using FieldsView = Record1::View;
+
+/**
+ * @brief Bit mask selecting records of an Entry by position
+ */
+using RecordMask = uint32_t;
 
-class Entry {
+/**
+ * @brief The BasicEntry class holds the records of one Redis hash, one record per field.
+ *        Records may be loaded selectively: reading or modifying a record that was not
+ *        loaded throws std::runtime_error, and only loaded records that changed since they
+ *        were read or stored are written back.
+ *
+ * @tparam Records - record tags, each with NAME, CAPACITY, Fields and View members
+ */
+template<class... Records>
+class BasicEntry {
 public:
-    explicit Entry(const std::string &key);
+    static constexpr std::size_t RECORDS = sizeof...(Records);
+
+    static_assert(RECORDS > 0 && RECORDS < 32, "BasicEntry supports 1 to 31 records");
+
+    static constexpr RecordMask ALL_RECORDS = (RecordMask(1) << RECORDS) - 1;
+
+    /**
+     * @brief Return the position of a record
+     */
+    template<class Record>
+    static constexpr std::size_t index() {
+        constexpr bool matches[] = { std::is_same<Record, Records>::value... };
+        for (std::size_t i = 0; i < RECORDS; i++) {
+            if (matches[i]) {
+                return i;
+            }
+        }
+        return RECORDS;
+    }
+
+    /**
+     * @brief Return the mask selecting a record
+     */
+    template<class Record>
+    static constexpr RecordMask mask() {
+        static_assert(index<Record>() < RECORDS, "Record is not part of this Entry");
+        return RecordMask(1) << index<Record>();
+    }
 
-    Entry(const std::string &key, std::unordered_map<std::string, std::string> &data);
+    /**
+     * @brief Return the hash field name of a record
+     *
+     * @param idx - record position
+     * @return const char* - field name, nullptr if idx is out of range
+     */
+    static const char *name(std::size_t idx);
 
-    ~Entry() = default;
+    /**
+     * @brief Return the maximum number of keys of a record
+     *
+     * @param idx - record position
+     * @return std::size_t - capacity, 0 if idx is out of range
+     */
+    static std::size_t capacity(std::size_t idx);
+
+    /**
+     * @brief Construct a new entry with every record loaded, empty and not yet stored
+     */
+    explicit BasicEntry(const std::string &key);
+
+    /**
+     * @brief Construct an entry from an HGETALL reply, see refresh()
+     */
+    BasicEntry(const std::string &key, std::unordered_map<std::string, std::string> &data);
+
+    ~BasicEntry() = default;
 
     // Copy construction and assignment
-    Entry(const Entry &rhs) = default;
-    Entry& operator=(const Entry &rhs) = default;
+    BasicEntry(const BasicEntry &rhs) = default;
+    BasicEntry& operator=(const BasicEntry &rhs) = default;
 
+    /**
+     * @brief Load every record from an HGETALL reply, taking ownership of the field buffers.
+     *        A record whose field is absent is loaded empty.
+     */
     void refresh(std::unordered_map<std::string, std::string> &data);
 
+    /**
+     * @brief Load one record from its hash field, taking ownership of the buffer
+     *
+     * @param idx - record position
+     * @param data - field value, empty if the field is absent
+     */
+    void refresh(std::size_t idx, std::string &&data);
+
+    /**
+     * @brief Load one record as a view over a serialized Dict owned by someone else, such as
+     *        a mapped file
+     *
+     * @param idx - record position
+     * @param buffer - serialized Dict, kept alive by the Entry and its copies
+     * @param size - buffer size, 0 for an empty record
+     */
+    void refresh(std::size_t idx, std::shared_ptr<const char> buffer, std::size_t size);
+
+    /**
+     * @brief Drop records, which then have to be loaded again before use
+     *
+     * @param records - records to drop
+     */
+    void unload(RecordMask records);
+
+    /**
+     * @brief Return a mutable record, copying it out of the reply buffer first if the
+     *        Entry currently holds a view
+     */
+    template<class Record>
+    typename Record::Fields &get() {
+        auto &state = loadedState<Record>();
+        if (state.m_buffer) {
+            state.m_fields.refresh(state.m_view.data(), state.m_view.container_size());
+            state.m_view = typename Record::View();
+            state.m_buffer.reset();
+        }
+        return state.m_fields;
+    }
+
+    /**
+     * @brief Return a read-only view of a record without copying it
+     */
+    template<class Record>
+    typename Record::View view() const {
+        auto &state = loadedState<Record>();
+        if (state.m_buffer) {
+            return state.m_view;
+        }
+        return typename Record::View(state.m_fields.data(), state.m_fields.container_size());
+    }
+
     Fields &getRecord1() {
-        return m_record1;
+        return get<Record1>();
     }
 
-    const char *data(int idx);
+    FieldsView viewRecord1() const {
+        return view<Record1>();
+    }
 
-    size_t size(int idx) const;
+    /**
+     * @brief Return the records currently loaded
+     */
+    RecordMask loaded() const;
 
-    void dump(std::shared_ptr<spdlog::logger> logger);
+    /**
+     * @brief Return the loaded records changed since they were read or stored
+     */
+    RecordMask dirty() const;
+
+    /**
+     * @brief Return indication of whether a dirty record can be stored by patching the
+     *        values changed with set(), rather than written in full
+     */
+    bool patchable(std::size_t idx) const;
+
+    /**
+     * @brief Return the hash of a record's keys, as stored in its serialized header
+     */
+    uint32_t keysHash(std::size_t idx) const;
+
+    /**
+     * @brief Visit each run of values of a record changed with set() as a byte range of the
+     *        compact serialized form
+     */
+    void forEachDirtyRange(std::size_t idx, const std::function<void(std::size_t, const char*, std::size_t)> &patch) const;
+
+    /**
+     * @brief Mark the loaded records as matching what is stored in Redis
+     */
+    void clean();
+
+    /**
+     * @brief Return the compact serialized form of a record, nullptr if it is not loaded
+     */
+    const char *data(std::size_t idx);
+
+    /**
+     * @brief Return the size of the compact serialized form of a record
+     */
+    size_t size(std::size_t idx) const;
+
+    /**
+     * @brief Return the approximate number of bytes of memory held by the Entry
+     */
+    size_t footprint() const;
+
+    void dump(std::shared_ptr<spdlog::logger> logger) const;
 
 private:
+    template<class Record>
+    struct RecordState {
+        typename Record::Fields m_fields;
+        // Buffer backing m_view when the record has not been copied into m_fields
+        std::shared_ptr<const char> m_buffer;
+        typename Record::View m_view;
+        // Scratch buffer holding the serialized form returned by data()
+        std::string m_wire;
+        bool m_loaded = true;
+        // The record was read from or written to Redis (changes since are tracked by m_fields)
+        bool m_stored = false;
+    };
+
+    template<class Record>
+    RecordState<Record> &loadedState() {
+        auto &state = std::get<RecordState<Record>>(m_records);
+        if (!state.m_loaded) {
+            throw std::runtime_error(std::string("Record not loaded: ") + Record::NAME);
+        }
+        return state;
+    }
+
+    template<class Record>
+    const RecordState<Record> &loadedState() const {
+        return const_cast<BasicEntry*>(this)->loadedState<Record>();
+    }
+
+    /**
+     * @brief Invoke f(idx, state) for every record
+     */
+    template<class F>
+    void forEachRecord(F &&f) {
+        forEachRecord(std::forward<F>(f), std::index_sequence_for<Records...>());
+    }
+
+    template<class F>
+    void forEachRecord(F &&f) const {
+        const_cast<BasicEntry*>(this)->forEachRecord([&f] (std::size_t idx, const auto &state) { f(idx, state); });
+    }
+
+    template<class F, std::size_t... I>
+    void forEachRecord(F &&f, std::index_sequence<I...>) {
+        (f(I, std::get<I>(m_records)), ...);
+    }
+
     std::string m_key;
-    Fields m_record1;
-};
\ No newline at end of file
+    std::tuple<RecordState<Records>...> m_records;
+};
+
+using Entry = BasicEntry<Record1, Record2>;
+
+extern template class BasicEntry<Record1, Record2>;
@@ -0,0 +1,152 @@
+#include <benchmark/benchmark.h>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "entrycache.h"
+#include "entrypool.h"
+
+/**
+ * Multi-threaded throughput of the Store read path: look up an entry snapshot in the cache
+ * and read a value from its record.  MutexLru is the single-lock LRU the cache replaced,
+ * where every lookup takes the lock exclusively to splice the entry to the front.
+ * BM_SnapshotCopy compares copying snapshots onto the heap and into an EntryPool.
+ */
+
+static const std::size_t KEYS = 10000;
+
+static std::string keyName(std::size_t i)
+{
+    return "entry:" + std::to_string(i);
+}
+
+/**
+ * @brief Build an Entry the way a read from Redis does, as a view over a reply buffer
+ */
+static EntryHandle makeEntry(const std::string &key)
+{
+    Entry entry(key);
+    for (uint32_t x = 1; x < 10; x++) {
+        entry.getRecord1().insert(x * 100, x);
+    }
+    std::unordered_map<std::string, std::string> fields {
+        { "record1", std::string(entry.data(0), entry.size(0)) }
+    };
+    return std::make_shared<const Entry>(key, fields);
+}
+
+class MutexLru {
+public:
+    void put(const std::string &key, const EntryHandle &entry) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lru.emplace_front(key, entry);
+        m_index[key] = m_lru.begin();
+    }
+
+    EntryHandle find(const std::string &key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto i = m_index.find(key);
+        if (i == m_index.end()) {
+            return nullptr;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, i->second);
+        return i->second->second;
+    }
+
+private:
+    using LruList = std::list<std::pair<std::string, EntryHandle>>;
+    std::mutex m_mutex;
+    LruList m_lru;
+    std::unordered_map<std::string, LruList::iterator> m_index;
+};
+
+/**
+ * @brief Caches shared by all benchmark threads, populated once
+ */
+template<class Cache>
+static Cache &sharedCache()
+{
+    static Cache *cache = [] {
+        auto c = new Cache();
+        for (std::size_t i = 0; i < KEYS; i++) {
+            auto key = keyName(i);
+            c->put(key, makeEntry(key));
+        }
+        return c;
+    }();
+    return *cache;
+}
+
+template<class Cache>
+static void BM_CacheRead(benchmark::State &state)
+{
+    auto &cache = sharedCache<Cache>();
+    std::vector<std::string> keys;
+    std::mt19937 gen(static_cast<uint32_t>(state.thread_index()));
+    std::uniform_int_distribution<std::size_t> dist(0, KEYS - 1);
+    for (std::size_t i = 0; i < 1024; i++) {
+        keys.push_back(keyName(dist(gen)));
+    }
+    std::size_t i = 0;
+    for (auto _: state) {
+        auto entry = cache.find(keys[i++ & 1023]);
+        benchmark::DoNotOptimize(entry->viewRecord1().at(500).m_value);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/**
+ * @brief 95% reads, 5% replacements of the entry just read
+ */
+static void BM_CacheMixed(benchmark::State &state)
+{
+    auto &cache = sharedCache<EntryCache>();
+    std::vector<std::string> keys;
+    std::mt19937 gen(static_cast<uint32_t>(state.thread_index()));
+    std::uniform_int_distribution<std::size_t> dist(0, KEYS - 1);
+    for (std::size_t i = 0; i < 1024; i++) {
+        keys.push_back(keyName(dist(gen)));
+    }
+    std::size_t i = 0;
+    for (auto _: state) {
+        auto &key = keys[i++ & 1023];
+        auto entry = cache.find(key);
+        if (i % 20 == 0) {
+            cache.put(key, std::make_shared<const Entry>(*entry));
+        } else {
+            benchmark::DoNotOptimize(entry->viewRecord1().at(500).m_value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/**
+ * @brief Copy an entry into a new snapshot and release the oldest of 256 live ones, as the
+ *        Store does on every read and write
+ */
+static void BM_SnapshotCopy(benchmark::State &state)
+{
+    static auto pool = EntryPool::create(entrySlotBytes());
+    auto source = makeEntry(nullptr, std::string("entry:0"));
+    for (uint32_t x = 1; x < 10; x++) {
+        source->getRecord1().insert(x * 100, x);
+    }
+    std::vector<std::shared_ptr<Entry>> live(256);
+    std::size_t i = 0;
+    for (auto _: state) {
+        live[i++ & 255] = makeEntry(state.range(0) ? pool : nullptr, *source);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    if (state.thread_index() == 0 && state.range(0)) {
+        state.counters["slabs"] = static_cast<double>(pool->stats().m_slabs);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_CacheRead, EntryCache)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CacheRead, MutexLru)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_CacheMixed)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_SnapshotCopy)->ArgName("pool")->Arg(0)->Arg(1)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include "entrycache.h"
+
+/**
+ * @brief Round up to a power of two, so a shard is picked with a mask rather than a division
+ */
+static std::size_t shardCount(std::size_t shards)
+{
+    std::size_t count = 1;
+    while (count < shards) {
+        count <<= 1;
+    }
+    return count;
+}
+
+EntryCache::EntryCache(std::size_t maxBytes, std::size_t shards):
+    m_shardBytes(maxBytes / shardCount(shards)),
+    m_shards(new Shard[shardCount(shards)]),
+    m_shardCount(shardCount(shards)),
+    m_counters(new Counters[COUNTER_STRIPES])
+{
+
+}
+
+EntryHandle EntryCache::find(const std::string &key, uint64_t *stamp)
+{
+    auto k = indexKey(key);
+    auto &s = shard(k);
+    std::shared_lock<std::shared_mutex> lock(s.m_mutex);
+    auto i = s.m_index.find(k);
+    if (i == s.m_index.end()) {
+        counters().m_misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    counters().m_hits.fetch_add(1, std::memory_order_relaxed);
+    auto &node = *i->second;
+    // Avoid dirtying the cache line when the bit is already set
+    if (!node.m_referenced.load(std::memory_order_relaxed)) {
+        node.m_referenced.store(true, std::memory_order_relaxed);
+    }
+    if (stamp) {
+        *stamp = node.m_stamp;
+    }
+    return node.m_entry;
+}
+
+EntryHandle EntryCache::peek(const std::string &key) const
+{
+    auto k = indexKey(key);
+    auto &s = shard(k);
+    std::shared_lock<std::shared_mutex> lock(s.m_mutex);
+    auto i = s.m_index.find(k);
+    return i != s.m_index.end() ? i->second->m_entry : nullptr;
+}
+
+void EntryCache::put(const std::string &key, const EntryHandle &entry, uint64_t stamp)
+{
+    std::size_t bytes = entry->footprint() + sizeof(Node) + key.size();
+    auto k = indexKey(key);
+    auto &s = shard(k);
+    std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+    auto i = s.m_index.find(k);
+    NodeList::iterator node;
+    if (i != s.m_index.end()) {
+        node = i->second;
+        s.m_bytes = s.m_bytes - node->m_bytes + bytes;
+        node->m_entry = entry;
+        node->m_bytes = bytes;
+        node->m_stamp = stamp;
+        node->m_referenced.store(true, std::memory_order_relaxed);
+    } else {
+        node = s.m_nodes.emplace(s.m_hand, key, k.m_hash, entry, bytes, stamp);
+        s.m_index.emplace(IndexKey{ node->m_key, k.m_hash }, node);
+        s.m_bytes += bytes;
+    }
+    evict(s, node);
+}
+
+bool EntryCache::erase(const std::string &key)
+{
+    auto k = indexKey(key);
+    auto &s = shard(k);
+    std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+    auto i = s.m_index.find(k);
+    if (i == s.m_index.end()) {
+        return false;
+    }
+    auto node = i->second;
+    s.m_bytes -= node->m_bytes;
+    s.m_index.erase(i);
+    if (s.m_hand == node) {
+        s.m_hand = s.m_nodes.erase(node);
+    } else {
+        s.m_nodes.erase(node);
+    }
+    return true;
+}
+
+void EntryCache::clear()
+{
+    for (std::size_t i = 0; i < m_shardCount; i++) {
+        auto &s = m_shards[i];
+        std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+        s.m_index.clear();
+        s.m_nodes.clear();
+        s.m_hand = s.m_nodes.end();
+        s.m_bytes = 0;
+    }
+}
+
+EntryCache::Stats EntryCache::stats() const
+{
+    Stats stats;
+    for (std::size_t i = 0; i < m_shardCount; i++) {
+        auto &s = m_shards[i];
+        std::shared_lock<std::shared_mutex> lock(s.m_mutex);
+        stats.m_evictions += s.m_evictions;
+        stats.m_entries += s.m_index.size();
+        stats.m_bytes += s.m_bytes;
+    }
+    for (std::size_t i = 0; i < COUNTER_STRIPES; i++) {
+        stats.m_hits += m_counters[i].m_hits.load(std::memory_order_relaxed);
+        stats.m_misses += m_counters[i].m_misses.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void EntryCache::forEach(const std::function<void(const std::string&, const EntryHandle&, uint64_t)> &visit) const
+{
+    for (std::size_t i = 0; i < m_shardCount; i++) {
+        auto &s = m_shards[i];
+        std::shared_lock<std::shared_mutex> lock(s.m_mutex);
+        for (const auto &node: s.m_nodes) {
+            visit(node.m_key, node.m_entry, node.m_stamp);
+        }
+    }
+}
+
+EntryCache::IndexKey EntryCache::indexKey(const std::string &key) const
+{
+    return IndexKey{ key, std::hash<std::string>()(key) };
+}
+
+EntryCache::Shard &EntryCache::shard(const IndexKey &key) const
+{
+    // High bits pick the shard, the index buckets use the hash modulo a prime
+    return m_shards[(key.m_hash >> 16) & (m_shardCount - 1)];
+}
+
+EntryCache::Counters &EntryCache::counters() const
+{
+    static thread_local std::size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % COUNTER_STRIPES;
+    return m_counters[stripe];
+}
+
+void EntryCache::evict(Shard &s, NodeList::iterator inserted)
+{
+    // Never evict the entry just inserted or updated
+    while (s.m_bytes > m_shardBytes && s.m_nodes.size() > 1) {
+        if (s.m_hand == s.m_nodes.end()) {
+            s.m_hand = s.m_nodes.begin();
+        }
+        if (s.m_hand == inserted || s.m_hand->m_referenced.exchange(false, std::memory_order_relaxed)) {
+            ++s.m_hand;
+            continue;
+        }
+        s.m_bytes -= s.m_hand->m_bytes;
+        s.m_index.erase(IndexKey{ s.m_hand->m_key, s.m_hand->m_hash });
+        s.m_hand = s.m_nodes.erase(s.m_hand);
+        s.m_evictions++;
+    }
+}
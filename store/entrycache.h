@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "entry.h"
+
+/**
+ * @brief Shared handle to an immutable cached Entry snapshot.  Cached entries are replaced,
+ *        never modified, so a handle can be read from any thread and stays valid after the
+ *        Entry is evicted or replaced.  Copy the Entry to modify it.
+ */
+using EntryHandle = std::shared_ptr<const Entry>;
+
+/**
+ * @brief The EntryCache class is a bounded cache of Entry snapshots keyed by Redis key.
+ *        Keys are spread over shards by hash.  Lookups take a shard's lock shared and only
+ *        set the entry's CLOCK reference bit, so readers never block each other.  Inserts take
+ *        it exclusive and evict entries not referenced since the clock hand last passed once
+ *        the shard exceeds its share of the byte budget.
+ */
+class EntryCache {
+public:
+    static constexpr std::size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_SHARDS = 64;
+
+    /**
+     * @brief Cache counters, summed over all shards
+     */
+    struct Stats {
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+        uint64_t m_evictions = 0;
+        std::size_t m_entries = 0;
+        std::size_t m_bytes = 0;
+    };
+
+    /**
+     * @brief Construct a new EntryCache object
+     *
+     * @param maxBytes - byte budget, split evenly between the shards
+     * @param shards - number of shards, rounded up to a power of two
+     */
+    explicit EntryCache(std::size_t maxBytes = DEFAULT_MAX_BYTES, std::size_t shards = DEFAULT_SHARDS);
+
+    ~EntryCache() = default;
+
+    EntryCache(const EntryCache &) = delete;
+    EntryCache& operator=(const EntryCache &) = delete;
+
+    /**
+     * @brief Look up an entry, marking it referenced and counting a hit or miss
+     *
+     * @param key - Redis key
+     * @param stamp - if not null, receives the stamp the entry was cached with
+     * @return EntryHandle - cached entry or nullptr if not cached
+     */
+    EntryHandle find(const std::string &key, uint64_t *stamp = nullptr);
+
+    /**
+     * @brief Look up an entry without marking it referenced or counting a hit or miss
+     *
+     * @param key - Redis key
+     * @return EntryHandle - cached entry or nullptr if not cached
+     */
+    EntryHandle peek(const std::string &key) const;
+
+    /**
+     * @brief Insert or replace an entry, charging its footprint to the budget and evicting
+     *        unreferenced entries of the same shard to make room.  An entry larger than a
+     *        shard's budget is still cached, as the only entry of its shard.
+     *
+     * @param key - Redis key
+     * @param entry - entry to cache
+     * @param stamp - caller defined validity stamp kept with the entry
+     */
+    void put(const std::string &key, const EntryHandle &entry, uint64_t stamp = 0);
+
+    /**
+     * @brief Remove an entry from the cache
+     *
+     * @param key - Redis key
+     * @return true - entry removed
+     * @return false - entry was not cached
+     */
+    bool erase(const std::string &key);
+
+    /**
+     * @brief Remove every entry from the cache, keeping the counters
+     */
+    void clear();
+
+    Stats stats() const;
+
+    /**
+     * @brief Visit every cached entry, one shard at a time.  The visitor runs under the
+     *        shard's shared lock and must not call back into the cache.
+     *
+     * @param visit - invoked as visit(const std::string &key, const EntryHandle &entry, uint64_t stamp)
+     */
+    void forEach(const std::function<void(const std::string&, const EntryHandle&, uint64_t)> &visit) const;
+
+private:
+    struct Node {
+        Node(const std::string &key, std::size_t hash, const EntryHandle &entry, std::size_t bytes, uint64_t stamp):
+            m_key(key), m_hash(hash), m_entry(entry), m_bytes(bytes), m_stamp(stamp), m_referenced(true)
+        {}
+
+        std::string m_key;
+        std::size_t m_hash;
+        EntryHandle m_entry;
+        std::size_t m_bytes;
+        uint64_t m_stamp;
+        // Set by lookups under the shared lock, cleared by the clock hand
+        mutable std::atomic_bool m_referenced;
+    };
+
+    using NodeList = std::list<Node>;
+
+    /**
+     * @brief Index key carrying its hash, so a lookup hashes the key once for both the shard
+     *        and the index
+     */
+    struct IndexKey {
+        std::string_view m_key;
+        std::size_t m_hash;
+
+        bool operator==(const IndexKey &rhs) const {
+            return m_hash == rhs.m_hash && m_key == rhs.m_key;
+        }
+    };
+
+    struct IndexHash {
+        std::size_t operator()(const IndexKey &key) const {
+            return key.m_hash;
+        }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex m_mutex;
+        // Clock ring, new entries go just behind the hand; index keys point into the nodes
+        NodeList m_nodes;
+        NodeList::iterator m_hand = m_nodes.end();
+        std::unordered_map<IndexKey, NodeList::iterator, IndexHash> m_index;
+        std::size_t m_bytes = 0;
+        uint64_t m_evictions = 0;
+    };
+
+    /**
+     * @brief Hit and miss counters, striped by thread so concurrent readers do not contend
+     *        on a shared cache line
+     */
+    struct alignas(64) Counters {
+        std::atomic<uint64_t> m_hits{0};
+        std::atomic<uint64_t> m_misses{0};
+    };
+
+    static constexpr std::size_t COUNTER_STRIPES = 64;
+
+    IndexKey indexKey(const std::string &key) const;
+
+    Counters &counters() const;
+
+    Shard &shard(const IndexKey &key) const;
+
+    void evict(Shard &shard, NodeList::iterator inserted);
+
+    std::size_t m_shardBytes;
+    std::unique_ptr<Shard[]> m_shards;
+    std::size_t m_shardCount;
+    std::unique_ptr<Counters[]> m_counters;
+};
@@ -0,0 +1,243 @@
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <unordered_set>
+#include "entrypool.h"
+
+static std::atomic<uint64_t> nextPoolId{1};
+
+/**
+ * @brief Ids of the pools not yet destroyed, consulted when a thread runs out of free lists
+ */
+static std::mutex &livePoolsMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::unordered_set<uint64_t> &livePools()
+{
+    static std::unordered_set<uint64_t> pools;
+    return pools;
+}
+
+std::shared_ptr<EntryPool> EntryPool::create(std::size_t slotBytes, bool hugePages, std::size_t shards)
+{
+    return std::shared_ptr<EntryPool>(new EntryPool(slotBytes, hugePages, shards),
+                                      [] (EntryPool *pool) { pool->release(); });
+}
+
+EntryPool::EntryPool(std::size_t slotBytes, bool hugePages, std::size_t shards):
+    m_slotBytes((std::max(slotBytes, sizeof(FreeSlot)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+    m_hugePages(hugePages),
+    m_id(nextPoolId.fetch_add(1)),
+    m_shards(new Shard[std::max<std::size_t>(shards, 1)]),
+    m_shardCount(std::max<std::size_t>(shards, 1))
+{
+    std::lock_guard<std::mutex> lock(livePoolsMutex());
+    livePools().insert(m_id);
+}
+
+EntryPool::~EntryPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(livePoolsMutex());
+        livePools().erase(m_id);
+    }
+    for (std::size_t i = 0; i < m_shardCount; i++) {
+        for (auto slab: m_shards[i].m_slabs) {
+            munmap(slab, SLAB_BYTES);
+        }
+    }
+}
+
+void *EntryPool::allocate(std::size_t bytes)
+{
+    if (bytes > m_slotBytes) {
+        m_oversize.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(bytes);
+    }
+    shard().m_allocations.fetch_add(1, std::memory_order_relaxed);
+    auto slots = threadSlots();
+    if (slots) {
+        if (!slots->m_free) {
+            refill(*slots);
+        }
+        auto slot = slots->m_free;
+        slots->m_free = slot->m_next;
+        slots->m_count--;
+        return slot;
+    }
+    // This thread's free lists all serve other pools: take a batch and hand the rest back
+    ThreadSlots batch;
+    refill(batch);
+    auto slot = batch.m_free;
+    batch.m_free = slot->m_next;
+    if (--batch.m_count) {
+        spill(batch);
+    }
+    return slot;
+}
+
+void EntryPool::deallocate(void *p, std::size_t bytes)
+{
+    // Counting the release is the last use of the pool, which release() may destroy as soon
+    // as every slot is counted back
+    if (bytes > m_slotBytes) {
+        ::operator delete(p);
+        m_oversizeFrees.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    auto &frees = shard().m_frees;
+    auto slot = static_cast<FreeSlot*>(p);
+    auto slots = threadSlots();
+    if (slots) {
+        slot->m_next = slots->m_free;
+        slots->m_free = slot;
+        if (++slots->m_count >= 2 * BATCH) {
+            spill(*slots);
+        }
+    } else {
+        auto &s = shard();
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+        slot->m_next = s.m_free;
+        s.m_free = slot;
+    }
+    frees.fetch_add(1, std::memory_order_release);
+}
+
+void EntryPool::release()
+{
+    auto stats = this->stats();
+    // Slots still in use keep the pool, for the rest of the process
+    if (stats.m_slotsInUse == 0 && stats.m_oversize == m_oversizeFrees.load(std::memory_order_acquire)) {
+        delete this;
+    }
+}
+
+EntryPool::Stats EntryPool::stats() const
+{
+    Stats stats;
+    for (std::size_t i = 0; i < m_shardCount; i++) {
+        auto &s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+        stats.m_allocations += s.m_allocations.load(std::memory_order_relaxed);
+        stats.m_frees += s.m_frees.load(std::memory_order_acquire);
+        stats.m_slabs += s.m_slabs.size();
+        stats.m_hugeSlabs += s.m_hugeSlabs;
+    }
+    stats.m_oversize = m_oversize.load(std::memory_order_relaxed);
+    stats.m_slotBytes = m_slotBytes;
+    stats.m_slotsInUse = static_cast<std::size_t>(stats.m_allocations - stats.m_frees);
+    return stats;
+}
+
+EntryPool::Shard &EntryPool::shard() const
+{
+    static thread_local std::size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return m_shards[stripe % m_shardCount];
+}
+
+EntryPool::ThreadSlots *EntryPool::threadSlots() const
+{
+    static thread_local ThreadSlots lists[THREAD_POOLS];
+    ThreadSlots *idle = nullptr;
+    for (auto &slots: lists) {
+        if (slots.m_pool == m_id) {
+            return &slots;
+        }
+        if (!idle && slots.m_count == 0) {
+            idle = &slots;
+        }
+    }
+    if (!idle) {
+        // Slots listed for a destroyed pool were unmapped with it: drop them unread
+        std::lock_guard<std::mutex> lock(livePoolsMutex());
+        for (auto &slots: lists) {
+            if (!livePools().count(slots.m_pool)) {
+                idle = &slots;
+                break;
+            }
+        }
+        if (!idle) {
+            return nullptr;
+        }
+    }
+    idle->m_pool = m_id;
+    idle->m_free = nullptr;
+    idle->m_count = 0;
+    return idle;
+}
+
+void EntryPool::refill(ThreadSlots &slots)
+{
+    auto &s = shard();
+    std::lock_guard<std::mutex> lock(s.m_mutex);
+    while (s.m_free && slots.m_count < BATCH) {
+        auto slot = s.m_free;
+        s.m_free = slot->m_next;
+        slot->m_next = slots.m_free;
+        slots.m_free = slot;
+        slots.m_count++;
+    }
+    if (slots.m_count) {
+        return;
+    }
+    // Carve a batch from the newest slab, mapping a new one when it is used up
+    for (std::size_t i = 0; i < BATCH; i++) {
+        if (s.m_next + m_slotBytes > s.m_end) {
+            if (i > 0) {
+                break;
+            }
+            bool huge = false;
+            auto slab = static_cast<char*>(mapSlab(huge));
+            s.m_slabs.push_back(slab);
+            s.m_hugeSlabs += huge ? 1 : 0;
+            s.m_next = slab;
+            s.m_end = slab + SLAB_BYTES;
+        }
+        auto slot = reinterpret_cast<FreeSlot*>(s.m_next);
+        s.m_next += m_slotBytes;
+        slot->m_next = slots.m_free;
+        slots.m_free = slot;
+        slots.m_count++;
+    }
+}
+
+void EntryPool::spill(ThreadSlots &slots)
+{
+    auto &s = shard();
+    std::lock_guard<std::mutex> lock(s.m_mutex);
+    for (std::size_t i = 0; i < BATCH && slots.m_free; i++) {
+        auto slot = slots.m_free;
+        slots.m_free = slot->m_next;
+        slots.m_count--;
+        slot->m_next = s.m_free;
+        s.m_free = slot;
+    }
+}
+
+void *EntryPool::mapSlab(bool &huge)
+{
+    void *slab = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (m_hugePages) {
+        slab = mmap(nullptr, SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = (slab != MAP_FAILED);
+    }
+#endif
+    if (slab == MAP_FAILED) {
+        slab = mmap(nullptr, SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        // No huge pages reserved: ask for transparent huge pages instead
+        if (m_hugePages) {
+            madvise(slab, SLAB_BYTES, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return slab;
+}
@@ -0,0 +1,216 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "entry.h"
+
+/**
+ * @brief The EntryPool class hands out fixed-size slots carved from large slabs, for the
+ *        Entry snapshots shared by the Store and its cache.  Slabs are mapped from the kernel
+ *        and optionally backed by huge pages; they are only returned when the pool is
+ *        destroyed.  Allocation and release are O(1) pops and pushes on intrusive free lists:
+ *        each thread keeps a small list of its own per pool (for up to THREAD_POOLS pools),
+ *        refilled from and spilled to free lists sharded by thread, so the common case takes
+ *        no lock.  A slot may be released by any
+ *        thread.  Slots cached by a thread that exits are not reused.
+ *
+ *        The pool is created with create() and destroyed when its last handle is released.
+ *        If slots are still in use at that point the pool is left in place for the rest of
+ *        the process, so Entries allocated from it may safely outlive their creator.
+ */
+class EntryPool {
+public:
+    static constexpr std::size_t SLAB_BYTES = 2 * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_SHARDS = 16;
+
+    /**
+     * @brief Pool counters, summed over all shards
+     */
+    struct Stats {
+        uint64_t m_allocations = 0;
+        uint64_t m_frees = 0;
+        // Requests larger than a slot, passed on to operator new
+        uint64_t m_oversize = 0;
+        std::size_t m_slabs = 0;
+        // Slabs backed by explicit huge pages (MAP_HUGETLB)
+        std::size_t m_hugeSlabs = 0;
+        std::size_t m_slotBytes = 0;
+        std::size_t m_slotsInUse = 0;
+    };
+
+    /**
+     * @brief Create a new EntryPool
+     *
+     * @param slotBytes - slot size, rounded up to a multiple of the maximum alignment
+     * @param hugePages - back slabs with huge pages, falling back to transparent huge pages
+     *                    and then regular pages if none are reserved
+     * @param shards - number of free list shards
+     * @return std::shared_ptr<EntryPool> - handle to the pool
+     */
+    static std::shared_ptr<EntryPool> create(std::size_t slotBytes, bool hugePages = false,
+                                             std::size_t shards = DEFAULT_SHARDS);
+
+    EntryPool(const EntryPool &) = delete;
+    EntryPool& operator=(const EntryPool &) = delete;
+
+    /**
+     * @brief Allocate a slot, or forward the request to operator new if it does not fit
+     *
+     * @param bytes - bytes requested
+     * @return void* - allocated memory, throws std::bad_alloc if no slab can be mapped
+     */
+    void *allocate(std::size_t bytes);
+
+    /**
+     * @brief Release memory returned by allocate()
+     *
+     * @param p - memory to release
+     * @param bytes - bytes requested when it was allocated
+     */
+    void deallocate(void *p, std::size_t bytes);
+
+    std::size_t slotBytes() const {
+        return m_slotBytes;
+    }
+
+    Stats stats() const;
+
+private:
+    // Slots moved at once between a thread's free list and the shards
+    static constexpr std::size_t BATCH = 32;
+    // Pools a thread keeps free lists for at once, further pools go through the shards
+    static constexpr std::size_t THREAD_POOLS = 4;
+
+    struct FreeSlot {
+        FreeSlot *m_next;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex m_mutex;
+        FreeSlot *m_free = nullptr;
+        // Unused tail of the shard's newest slab
+        char *m_next = nullptr;
+        char *m_end = nullptr;
+        std::vector<void*> m_slabs;
+        std::size_t m_hugeSlabs = 0;
+        // Updated without the lock by the threads striped onto the shard
+        std::atomic<uint64_t> m_allocations{0};
+        std::atomic<uint64_t> m_frees{0};
+    };
+
+    /**
+     * @brief Free list of the calling thread for one pool
+     */
+    struct ThreadSlots {
+        uint64_t m_pool = 0;
+        FreeSlot *m_free = nullptr;
+        std::size_t m_count = 0;
+    };
+
+    EntryPool(std::size_t slotBytes, bool hugePages, std::size_t shards);
+
+    ~EntryPool();
+
+    /**
+     * @brief Release the last handle, destroying the pool unless slots are still in use
+     */
+    void release();
+
+    Shard &shard() const;
+
+    /**
+     * @brief Return the calling thread's free list for this pool, taking over one that is
+     *        empty or whose pool is gone, else nullptr if all hold slots of other live pools
+     */
+    ThreadSlots *threadSlots() const;
+
+    /**
+     * @brief Move up to BATCH free slots from the calling thread's shard to its free list
+     */
+    void refill(ThreadSlots &slots);
+
+    /**
+     * @brief Move BATCH free slots from the calling thread's free list to its shard
+     */
+    void spill(ThreadSlots &slots);
+
+    void *mapSlab(bool &huge);
+
+    std::size_t m_slotBytes;
+    bool m_hugePages;
+    // Identifies the pool to the thread free lists, never reused
+    uint64_t m_id;
+    std::unique_ptr<Shard[]> m_shards;
+    std::size_t m_shardCount;
+    std::atomic<uint64_t> m_oversize{0};
+    std::atomic<uint64_t> m_oversizeFrees{0};
+};
+
+/**
+ * @brief Standard allocator drawing single objects from an EntryPool, for use with
+ *        std::allocate_shared.  The allocator does not hold a reference to the pool, which
+ *        outlives the memory allocated from it (see EntryPool).
+ */
+template<class T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(EntryPool *pool): m_pool(pool)
+    {
+    }
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U> &rhs): m_pool(rhs.pool())
+    {
+    }
+
+    T *allocate(std::size_t n) {
+        return static_cast<T*>(m_pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        m_pool->deallocate(p, n * sizeof(T));
+    }
+
+    EntryPool *pool() const {
+        return m_pool;
+    }
+
+    template<class U>
+    bool operator==(const PoolAllocator<U> &rhs) const {
+        return m_pool == rhs.pool();
+    }
+
+    template<class U>
+    bool operator!=(const PoolAllocator<U> &rhs) const {
+        return m_pool != rhs.pool();
+    }
+
+private:
+    EntryPool *m_pool;
+};
+
+/**
+ * @brief Return the slot size holding an Entry and its shared_ptr control block
+ */
+constexpr std::size_t entrySlotBytes()
+{
+    // The control block adds its vtable pointer, use counts and the allocator
+    return sizeof(Entry) + 64;
+}
+
+/**
+ * @brief Construct an Entry in a slot of the pool, or on the heap if pool is null
+ */
+template<class... Args>
+std::shared_ptr<Entry> makeEntry(const std::shared_ptr<EntryPool> &pool, Args&&... args)
+{
+    if (!pool) {
+        return std::make_shared<Entry>(std::forward<Args>(args)...);
+    }
+    return std::allocate_shared<Entry>(PoolAllocator<Entry>(pool.get()), std::forward<Args>(args)...);
+}
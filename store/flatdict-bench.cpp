@@ -0,0 +1,350 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "flatdict.h"
+#include "smalldict.h"
+#include "flatdict-bench.h"
+
+/**
+ * @brief Reference copy of the original Dict insert which re-sorts every key on each insert
+ */
+template<std::size_t N>
+class LegacyInsertDict {
+public:
+    bool insert(const uint32_t &key, const BenchValue &value)
+    {
+        if (m_size == N) {
+            return false;
+        }
+        for (std::size_t i = 0; i < m_size; i++) {
+            if (m_keys[i].m_key == key) {
+                return false;
+            }
+        }
+        m_keys[m_size].m_key = key;
+        m_keys[m_size].m_index = static_cast<uint32_t>(m_size);
+        m_values[m_size] = value;
+        m_size++;
+        std::sort(&m_keys[0], &m_keys[m_size],
+            [](const dict::Key &a, const dict::Key &b)
+            { return a.m_key < b.m_key; });
+        return true;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    std::size_t m_size = 0;
+    std::array<dict::Key,N> m_keys;
+    std::array<BenchValue,N> m_values;
+};
+
+template<std::size_t N>
+static void BM_InsertLegacy(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    for (auto _: state) {
+        LegacyInsertDict<N> d;
+        for (const auto &elt: batch) {
+            d.insert(elt.first, elt.second);
+        }
+        benchmark::DoNotOptimize(d);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+template<std::size_t N>
+static void BM_InsertSorted(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    for (auto _: state) {
+        dict::Dict<BenchValue,N> d;
+        for (const auto &elt: batch) {
+            d.insert(elt.first, elt.second);
+        }
+        benchmark::DoNotOptimize(d);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+template<std::size_t N>
+static void BM_InsertRange(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    for (auto _: state) {
+        dict::Dict<BenchValue,N> d;
+        d.insert_range(batch.begin(), batch.end());
+        benchmark::DoNotOptimize(d);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+/**
+ * @brief Build a sorted Key array of N keys for the raw search benchmarks
+ */
+template<std::size_t N>
+std::array<dict::Key,N> makeKeys()
+{
+    std::array<dict::Key,N> keys;
+    for (uint32_t x = 0; x < N; x++) {
+        keys[x].m_key = (x + 1) * 100;
+        keys[x].m_index = x;
+    }
+    return keys;
+}
+
+template<std::size_t N>
+static void BM_FindBinary(benchmark::State &state)
+{
+    auto keys = makeKeys<N>();
+    auto probes = makeBatch<N>();
+    for (auto _: state) {
+        for (const auto &elt: probes) {
+            auto i = dict::findKey(keys.data(), keys.data() + N, elt.first,
+                [] (const dict::Key &k, const uint32_t &key)
+                { return k.m_key < key; });
+            benchmark::DoNotOptimize(i);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+template<std::size_t N>
+static void BM_FindScan(benchmark::State &state)
+{
+    auto keys = makeKeys<N>();
+    auto probes = makeBatch<N>();
+    for (auto _: state) {
+        for (const auto &elt: probes) {
+            auto i = dict::scanKey(keys.data(), keys.data() + N, elt.first);
+            benchmark::DoNotOptimize(i);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+template<std::size_t N>
+static void BM_DictAt(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> d;
+    d.insert_range(batch.begin(), batch.end());
+    for (auto _: state) {
+        for (const auto &elt: batch) {
+            benchmark::DoNotOptimize(d.at(elt.first));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+/**
+ * @brief Read one field from a serialized Dict by copying it into a Dict first
+ */
+template<std::size_t N>
+static void BM_RefreshAt(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> src;
+    src.insert_range(batch.begin(), batch.end());
+    std::string blob(src.data(), src.container_size());
+    for (auto _: state) {
+        dict::Dict<BenchValue,N> d(blob.data(), blob.size());
+        benchmark::DoNotOptimize(d.at(batch[0].first));
+    }
+}
+
+/**
+ * @brief Read one field from a serialized Dict through a DictView
+ */
+template<std::size_t N>
+static void BM_ViewAt(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> src;
+    src.insert_range(batch.begin(), batch.end());
+    std::string blob(src.data(), src.container_size());
+    for (auto _: state) {
+        dict::DictView<BenchValue,N> v(blob.data(), blob.size());
+        benchmark::DoNotOptimize(v.at(batch[0].first));
+    }
+}
+
+/**
+ * @brief Field churn by rebuilding the Dict without the removed key (the only option before erase())
+ */
+template<std::size_t N>
+static void BM_ChurnRebuild(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> d;
+    d.insert_range(batch.begin(), batch.end());
+    std::size_t next = 0;
+    for (auto _: state) {
+        const uint32_t victim = batch[next % N].first;
+        dict::Dict<BenchValue,N> rebuilt;
+        for (auto i = d.cbegin(); i != d.cend(); ++i) {
+            if (i->m_key != victim) {
+                rebuilt.insert(i->m_key, d.at(i->m_key));
+            }
+        }
+        rebuilt.insert(victim, BenchValue(static_cast<uint32_t>(next)));
+        d = rebuilt;
+        next++;
+    }
+    benchmark::DoNotOptimize(d);
+}
+
+/**
+ * @brief Field churn with erase() followed by insert()
+ */
+template<std::size_t N>
+static void BM_ChurnErase(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> d;
+    d.insert_range(batch.begin(), batch.end());
+    std::size_t next = 0;
+    for (auto _: state) {
+        const uint32_t victim = batch[next % N].first;
+        d.erase(victim);
+        d.insert(victim, BenchValue(static_cast<uint32_t>(next)));
+        next++;
+    }
+    benchmark::DoNotOptimize(d);
+}
+
+template<std::size_t InlineN, std::size_t Count>
+static void BM_SmallDictInsert(benchmark::State &state)
+{
+    auto batch = makeBatch<Count>();
+    for (auto _: state) {
+        dict::SmallDict<BenchValue,InlineN> d;
+        for (const auto &elt: batch) {
+            d.insert(elt.first, elt.second);
+        }
+        benchmark::DoNotOptimize(d);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * Count));
+}
+
+template<std::size_t InlineN, std::size_t Count>
+static void BM_SmallDictAt(benchmark::State &state)
+{
+    auto batch = makeBatch<Count>();
+    dict::SmallDict<BenchValue,InlineN> d;
+    for (const auto &elt: batch) {
+        d.insert(elt.first, elt.second);
+    }
+    for (auto _: state) {
+        for (const auto &elt: batch) {
+            benchmark::DoNotOptimize(d.at(elt.first));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * Count));
+}
+
+/**
+ * @brief Look up a sorted set of Count keys (every other key, half of them misses) with repeated lookup()
+ *        calls, one search per key as find_many() does
+ */
+template<std::size_t N, std::size_t Count>
+static void BM_RepeatedAt(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> d;
+    d.insert_range(batch.begin(), batch.end());
+    std::array<uint32_t,Count> keys;
+    for (uint32_t x = 0; x < Count; x++) {
+        keys[x] = (x + 1) * 50;
+    }
+    for (auto _: state) {
+        for (const auto key: keys) {
+            benchmark::DoNotOptimize(d.lookup(key));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * Count));
+}
+
+/**
+ * @brief Look up the same keys as BM_RepeatedAt with a single find_many() merge pass
+ */
+template<std::size_t N, std::size_t Count>
+static void BM_FindMany(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N> d;
+    d.insert_range(batch.begin(), batch.end());
+    std::array<uint32_t,Count> keys;
+    for (uint32_t x = 0; x < Count; x++) {
+        keys[x] = (x + 1) * 50;
+    }
+    std::array<const BenchValue*,Count> out;
+    for (auto _: state) {
+        benchmark::DoNotOptimize(d.find_many(keys.data(), Count, out.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * Count));
+}
+
+template<std::size_t N>
+static void BM_FrozenAt(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    dict::Dict<BenchValue,N,dict::EytzingerLayout> d;
+    d.insert_range(batch.begin(), batch.end());
+    d.freeze();
+    for (auto _: state) {
+        for (const auto &elt: batch) {
+            benchmark::DoNotOptimize(d.at(elt.first));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * N));
+}
+
+BENCHMARK_TEMPLATE(BM_InsertLegacy, 20);
+BENCHMARK_TEMPLATE(BM_InsertSorted, 20);
+BENCHMARK_TEMPLATE(BM_InsertRange, 20);
+BENCHMARK_TEMPLATE(BM_InsertLegacy, 256);
+BENCHMARK_TEMPLATE(BM_InsertSorted, 256);
+BENCHMARK_TEMPLATE(BM_InsertRange, 256);
+BENCHMARK_TEMPLATE(BM_InsertLegacy, 1024);
+BENCHMARK_TEMPLATE(BM_InsertSorted, 1024);
+BENCHMARK_TEMPLATE(BM_InsertRange, 1024);
+
+BENCHMARK_TEMPLATE(BM_FindBinary, 8);
+BENCHMARK_TEMPLATE(BM_FindScan, 8);
+BENCHMARK_TEMPLATE(BM_FindBinary, 20);
+BENCHMARK_TEMPLATE(BM_FindScan, 20);
+BENCHMARK_TEMPLATE(BM_FindBinary, 64);
+BENCHMARK_TEMPLATE(BM_FindScan, 64);
+BENCHMARK_TEMPLATE(BM_DictAt, 20);
+BENCHMARK_TEMPLATE(BM_DictAt, 256);
+BENCHMARK_TEMPLATE(BM_RefreshAt, 20);
+BENCHMARK_TEMPLATE(BM_ViewAt, 20);
+BENCHMARK_TEMPLATE(BM_RefreshAt, 256);
+BENCHMARK_TEMPLATE(BM_ViewAt, 256);
+BENCHMARK_TEMPLATE(BM_ChurnRebuild, 20);
+BENCHMARK_TEMPLATE(BM_ChurnErase, 20);
+BENCHMARK_TEMPLATE(BM_ChurnRebuild, 256);
+BENCHMARK_TEMPLATE(BM_ChurnErase, 256);
+BENCHMARK_TEMPLATE(BM_SmallDictInsert, 8, 6);
+BENCHMARK_TEMPLATE(BM_SmallDictInsert, 8, 20);
+BENCHMARK_TEMPLATE(BM_SmallDictAt, 8, 6);
+BENCHMARK_TEMPLATE(BM_SmallDictAt, 8, 20);
+BENCHMARK_TEMPLATE(BM_RepeatedAt, 20, 5);
+BENCHMARK_TEMPLATE(BM_FindMany, 20, 5);
+BENCHMARK_TEMPLATE(BM_RepeatedAt, 20, 15);
+BENCHMARK_TEMPLATE(BM_FindMany, 20, 15);
+BENCHMARK_TEMPLATE(BM_RepeatedAt, 256, 15);
+BENCHMARK_TEMPLATE(BM_FindMany, 256, 15);
+BENCHMARK_TEMPLATE(BM_DictAt, 1024);
+BENCHMARK_TEMPLATE(BM_FrozenAt, 256);
+BENCHMARK_TEMPLATE(BM_FrozenAt, 1024);
+
+BENCHMARK_MAIN();
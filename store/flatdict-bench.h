@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Value type matching the layout of the store's Value
+ */
+struct BenchValue
+{
+    uint32_t m_value;
+    bool m_flag1;
+    bool m_flag2;
+
+    BenchValue() : m_value(0), m_flag1(false), m_flag2(false)
+    {
+    }
+
+    BenchValue(uint32_t value) : m_value(value), m_flag1(false), m_flag2(false)
+    {
+    }
+};
+
+/**
+ * @brief Generate N distinct keys in random order
+ */
+template<std::size_t N>
+std::vector<std::pair<uint32_t, BenchValue>> makeBatch()
+{
+    std::vector<std::pair<uint32_t, BenchValue>> batch;
+    for (uint32_t x = 0; x < N; x++) {
+        batch.emplace_back((x + 1) * 100, x);
+    }
+    std::mt19937 gen(42);
+    std::shuffle(batch.begin(), batch.end(), gen);
+    return batch;
+}
@@ -0,0 +1,350 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "flatdict.h"
+#include "flatdict-bench.h"
+
+/**
+ * Comparison of dict::Dict against standard containers holding the same uint32_t -> BenchValue
+ * mapping.  Each operation is reported as time per operation (time/op) and each container's
+ * memory footprint as bytes/entry, including heap allocations made by node based containers.
+ */
+
+/**
+ * @brief Heap bytes currently allocated through CountingAllocator
+ */
+static std::size_t allocatedBytes = 0;
+
+/**
+ * @brief Allocator that tracks the bytes allocated by a standard container
+ */
+template<class T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template<class U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        allocatedBytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        allocatedBytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<class U>
+    bool operator==(const CountingAllocator<U> &) const { return true; }
+
+    template<class U>
+    bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+
+/**
+ * @brief Serialize key/value pairs for the standard containers: count followed by the pairs
+ */
+template<class It>
+void writePairs(std::string &out, It first, It last, std::size_t count)
+{
+    out.resize(sizeof(uint32_t) + count * (sizeof(uint32_t) + sizeof(BenchValue)));
+    char *buf = &out[0];
+    uint32_t n = static_cast<uint32_t>(count);
+    memcpy(buf, &n, sizeof(n));
+    buf += sizeof(n);
+    for (; first != last; ++first) {
+        memcpy(buf, &first->first, sizeof(uint32_t));
+        memcpy(buf + sizeof(uint32_t), &first->second, sizeof(BenchValue));
+        buf += sizeof(uint32_t) + sizeof(BenchValue);
+    }
+}
+
+template<class Insert>
+void readPairs(const std::string &in, Insert insert)
+{
+    const char *buf = in.data();
+    uint32_t n = 0;
+    memcpy(&n, buf, sizeof(n));
+    buf += sizeof(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t key;
+        BenchValue value;
+        memcpy(&key, buf, sizeof(key));
+        memcpy(&value, buf + sizeof(key), sizeof(value));
+        insert(key, value);
+        buf += sizeof(uint32_t) + sizeof(BenchValue);
+    }
+}
+
+/**
+ * @brief Adapters giving each container the same insert/find/iterate/serialize/refresh interface
+ */
+template<std::size_t N>
+struct FlatDictAdapter {
+    using Container = dict::Dict<BenchValue,N>;
+
+    static void insert(Container &c, uint32_t key, const BenchValue &value) {
+        c.insert(key, value);
+    }
+
+    static const BenchValue *find(const Container &c, uint32_t key) {
+        return c.lookup(key);
+    }
+
+    static uint32_t iterate(const Container &c) {
+        uint32_t sum = 0;
+        for (const auto &key: c) {
+            sum += c.at(key).m_value;
+        }
+        return sum;
+    }
+
+    static void serialize(const Container &c, std::string &out) {
+        c.serialize(out);
+    }
+
+    static void refresh(Container &c, const std::string &in) {
+        c.refresh(in.data(), in.size());
+    }
+};
+
+template<std::size_t N>
+struct MapAdapter {
+    using Container = std::map<uint32_t, BenchValue, std::less<uint32_t>,
+                               CountingAllocator<std::pair<const uint32_t, BenchValue>>>;
+
+    static void insert(Container &c, uint32_t key, const BenchValue &value) {
+        c.emplace(key, value);
+    }
+
+    static const BenchValue *find(const Container &c, uint32_t key) {
+        auto i = c.find(key);
+        return i != c.end() ? &i->second : nullptr;
+    }
+
+    static uint32_t iterate(const Container &c) {
+        uint32_t sum = 0;
+        for (const auto &elt: c) {
+            sum += elt.second.m_value;
+        }
+        return sum;
+    }
+
+    static void serialize(const Container &c, std::string &out) {
+        writePairs(out, c.begin(), c.end(), c.size());
+    }
+
+    static void refresh(Container &c, const std::string &in) {
+        c.clear();
+        readPairs(in, [&] (uint32_t key, const BenchValue &value) { c.emplace_hint(c.end(), key, value); });
+    }
+};
+
+template<std::size_t N>
+struct UnorderedMapAdapter {
+    using Container = std::unordered_map<uint32_t, BenchValue, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                                         CountingAllocator<std::pair<const uint32_t, BenchValue>>>;
+
+    static void insert(Container &c, uint32_t key, const BenchValue &value) {
+        c.emplace(key, value);
+    }
+
+    static const BenchValue *find(const Container &c, uint32_t key) {
+        auto i = c.find(key);
+        return i != c.end() ? &i->second : nullptr;
+    }
+
+    static uint32_t iterate(const Container &c) {
+        uint32_t sum = 0;
+        for (const auto &elt: c) {
+            sum += elt.second.m_value;
+        }
+        return sum;
+    }
+
+    static void serialize(const Container &c, std::string &out) {
+        writePairs(out, c.begin(), c.end(), c.size());
+    }
+
+    static void refresh(Container &c, const std::string &in) {
+        c.clear();
+        readPairs(in, [&] (uint32_t key, const BenchValue &value) { c.emplace(key, value); });
+    }
+};
+
+template<std::size_t N>
+struct SortedVectorAdapter {
+    using Container = std::vector<std::pair<uint32_t, BenchValue>,
+                                  CountingAllocator<std::pair<uint32_t, BenchValue>>>;
+
+    static bool less(const std::pair<uint32_t, BenchValue> &elt, uint32_t key) {
+        return elt.first < key;
+    }
+
+    static void insert(Container &c, uint32_t key, const BenchValue &value) {
+        auto i = std::lower_bound(c.begin(), c.end(), key, less);
+        if (i == c.end() || i->first != key) {
+            c.emplace(i, key, value);
+        }
+    }
+
+    static const BenchValue *find(const Container &c, uint32_t key) {
+        auto i = std::lower_bound(c.begin(), c.end(), key, less);
+        return (i != c.end() && i->first == key) ? &i->second : nullptr;
+    }
+
+    static uint32_t iterate(const Container &c) {
+        uint32_t sum = 0;
+        for (const auto &elt: c) {
+            sum += elt.second.m_value;
+        }
+        return sum;
+    }
+
+    static void serialize(const Container &c, std::string &out) {
+        writePairs(out, c.begin(), c.end(), c.size());
+    }
+
+    static void refresh(Container &c, const std::string &in) {
+        c.clear();
+        readPairs(in, [&] (uint32_t key, const BenchValue &value) { c.emplace_back(key, value); });
+    }
+};
+
+/**
+ * @brief Report time per operation and the container footprint per entry
+ */
+template<class Adapter, std::size_t N>
+void setCounters(benchmark::State &state, std::size_t opsPerIteration)
+{
+    allocatedBytes = 0;
+    {
+        typename Adapter::Container c;
+        for (const auto &elt: makeBatch<N>()) {
+            Adapter::insert(c, elt.first, elt.second);
+        }
+        state.counters["bytes/entry"] = static_cast<double>(sizeof(c) + allocatedBytes) / N;
+    }
+    state.counters["time/op"] = benchmark::Counter(static_cast<double>(state.iterations() * opsPerIteration),
+                                                   benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_Insert(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    for (auto _: state) {
+        typename Adapter::Container c;
+        for (const auto &elt: batch) {
+            Adapter::insert(c, elt.first, elt.second);
+        }
+        benchmark::DoNotOptimize(c);
+    }
+    setCounters<Adapter,N>(state, N);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_LookupHit(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    typename Adapter::Container c;
+    for (const auto &elt: batch) {
+        Adapter::insert(c, elt.first, elt.second);
+    }
+    for (auto _: state) {
+        for (const auto &elt: batch) {
+            benchmark::DoNotOptimize(Adapter::find(c, elt.first));
+        }
+    }
+    setCounters<Adapter,N>(state, N);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_LookupMiss(benchmark::State &state)
+{
+    auto batch = makeBatch<N>();
+    typename Adapter::Container c;
+    for (const auto &elt: batch) {
+        Adapter::insert(c, elt.first, elt.second);
+    }
+    for (auto _: state) {
+        for (const auto &elt: batch) {
+            benchmark::DoNotOptimize(Adapter::find(c, elt.first + 50));
+        }
+    }
+    setCounters<Adapter,N>(state, N);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_Iterate(benchmark::State &state)
+{
+    typename Adapter::Container c;
+    for (const auto &elt: makeBatch<N>()) {
+        Adapter::insert(c, elt.first, elt.second);
+    }
+    for (auto _: state) {
+        benchmark::DoNotOptimize(Adapter::iterate(c));
+    }
+    setCounters<Adapter,N>(state, N);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_Serialize(benchmark::State &state)
+{
+    typename Adapter::Container c;
+    for (const auto &elt: makeBatch<N>()) {
+        Adapter::insert(c, elt.first, elt.second);
+    }
+    std::string out;
+    for (auto _: state) {
+        Adapter::serialize(c, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+    setCounters<Adapter,N>(state, 1);
+}
+
+template<class Adapter, std::size_t N>
+static void BM_Refresh(benchmark::State &state)
+{
+    typename Adapter::Container c;
+    for (const auto &elt: makeBatch<N>()) {
+        Adapter::insert(c, elt.first, elt.second);
+    }
+    std::string in;
+    Adapter::serialize(c, in);
+    for (auto _: state) {
+        Adapter::refresh(c, in);
+        benchmark::DoNotOptimize(c);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * in.size()));
+    setCounters<Adapter,N>(state, 1);
+}
+
+#define COMPARE_BENCHMARKS(Op, N) \
+    BENCHMARK_TEMPLATE(Op, FlatDictAdapter<N>, N); \
+    BENCHMARK_TEMPLATE(Op, MapAdapter<N>, N); \
+    BENCHMARK_TEMPLATE(Op, UnorderedMapAdapter<N>, N); \
+    BENCHMARK_TEMPLATE(Op, SortedVectorAdapter<N>, N)
+
+#define COMPARE_ALL_BENCHMARKS(N) \
+    COMPARE_BENCHMARKS(BM_Insert, N); \
+    COMPARE_BENCHMARKS(BM_LookupHit, N); \
+    COMPARE_BENCHMARKS(BM_LookupMiss, N); \
+    COMPARE_BENCHMARKS(BM_Iterate, N); \
+    COMPARE_BENCHMARKS(BM_Serialize, N); \
+    COMPARE_BENCHMARKS(BM_Refresh, N)
+
+COMPARE_ALL_BENCHMARKS(8);
+COMPARE_ALL_BENCHMARKS(20);
+COMPARE_ALL_BENCHMARKS(64);
+COMPARE_ALL_BENCHMARKS(256);
@@ -3,8 +3,31 @@
 #include <cstdint>
 #include <cstring>
 #include <array>
+#include <bitset>
+#include <cstddef>
+#include <functional>
 #include <algorithm>
+#include <iterator>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief DICT_SIMD_SEARCH selects the vectorized key scan for small Dicts.  It defaults to 
+ *        on when building for an ISA with SSE2 (AVX2 is used when available) and may be 
+ *        forced off with -DDICT_SIMD_SEARCH=0
+ */
+#ifndef DICT_SIMD_SEARCH
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define DICT_SIMD_SEARCH 1
+#else
+#define DICT_SIMD_SEARCH 0
+#endif
+#endif
+
+#if DICT_SIMD_SEARCH
+#include <immintrin.h>
+#endif
 
 namespace dict {
 
@@ -41,14 +64,472 @@ namespace dict {
             return last;
     }
 
+    /**
+     * @brief Dict capacity at or below which find() uses scanKey() rather than findKey().  The 
+     *        crossover point against the binary search is higher with 256-bit compares
+     */
+#if defined(__AVX2__)
+    constexpr std::size_t SIMD_SCAN_MAX = 64;
+#else
+    constexpr std::size_t SIMD_SCAN_MAX = 32;
+#endif
+
+    /**
+     * @brief linear scan for a Key based on the key value using SIMD compares.  Keys are 
+     *        stored as interleaved {m_index, m_key} pairs so only the odd 32-bit lanes of 
+     *        each vector are considered a match.  Any remainder is compared one key at a time.
+     * 
+     * @param first - pointer to first Key element
+     * @param last - pointer beyond the last Key element
+     * @param value - key value to search for
+     * @return const Key* - pointer to the desired Key element or last if not found
+     */
+    inline const Key* scanKey(const Key *first, const Key *last, const uint32_t value)
+    {
+#if DICT_SIMD_SEARCH && defined(__AVX2__)
+        const __m256i needle256 = _mm256_set1_epi32(static_cast<int>(value));
+        for (; last - first >= 4; first += 4) {
+            __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(keys, needle256))) & 0xAA;
+            if (mask) {
+                return first + (__builtin_ctz(static_cast<unsigned>(mask)) >> 1);
+            }
+        }
+#endif
+#if DICT_SIMD_SEARCH && defined(__SSE2__)
+        const __m128i needle128 = _mm_set1_epi32(static_cast<int>(value));
+        for (; last - first >= 4; first += 4) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 2));
+            int mask = (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, needle128))) |
+                        (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, needle128))) << 4)) & 0xAA;
+            if (mask) {
+                return first + (__builtin_ctz(static_cast<unsigned>(mask)) >> 1);
+            }
+        }
+        for (; last - first >= 2; first += 2) {
+            __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(keys, needle128))) & 0xA;
+            if (mask) {
+                return first + (__builtin_ctz(static_cast<unsigned>(mask)) >> 1);
+            }
+        }
+#endif
+        for (; first != last; ++first) {
+            if (first->m_key == value) {
+                return first;
+            }
+        }
+        return last;
+    }
+
+    /**
+     * @brief Header of the compact serialized form of a Dict.  The header is followed by 
+     *        m_count Key elements in search order and then m_count values.  The legacy 
+     *        serialized form is the raw fixed-size Dict (size_t count, N keys, N values) and 
+     *        is recognized by its size since its leading count can never equal WIRE_MAGIC.
+     *        m_keysHash identifies the keys and their value slots so that value bytes can be 
+     *        patched in place by a writer that knows the same key set (see wireKeysHash()).
+     *        m_version is WIRE_VERSION, WIRE_VERSION_BYTE_HASH buffers carry an older hash.
+     */
+    struct WireHeader {
+        uint32_t m_magic;
+        uint8_t m_version;
+        uint8_t m_layout;
+        uint16_t m_valueSize;
+        uint32_t m_count;
+        uint32_t m_keysHash;
+    };
+
+    constexpr uint32_t WIRE_MAGIC = 0x54434446;  // "FDCT"
+    constexpr uint8_t WIRE_VERSION = 2;
+    // Version 1 hashed the keys a byte at a time: such buffers are read, but not patched in place
+    constexpr uint8_t WIRE_VERSION_BYTE_HASH = 1;
+    constexpr uint8_t WIRE_LAYOUT_SORTED = 0;
+    constexpr uint8_t WIRE_LAYOUT_EYTZINGER = 1;
+
+    /**
+     * @brief Key layout policy: keys kept in ascending order and searched with scanKey()/findKey()
+     */
+    struct SortedLayout {
+    };
+
+    /**
+     * @brief Key layout policy for read-mostly Dicts: keys are kept sorted while the Dict is
+     *        being built and rearranged into Eytzinger (BFS) order by freeze(), after which
+     *        they are searched with the branchless eytzingerSearch()
+     */
+    struct EytzingerLayout {
+    };
+
+    /**
+     * @brief Visit the positions of an Eytzinger ordered array in ascending key order
+     * 
+     * @param count - number of elements
+     * @param visit - invoked as visit(std::size_t pos) for each position in key order
+     */
+    template<class Visit>
+    void eytzingerInOrder(std::size_t count, Visit visit)
+    {
+        // Positions are 1-based within the implicit tree: children of k are 2k and 2k+1
+        std::size_t k = 1;
+        while (2 * k <= count) {
+            k = 2 * k;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            visit(k - 1);
+            if (2 * k + 1 <= count) {
+                k = 2 * k + 1;
+                while (2 * k <= count) {
+                    k = 2 * k;
+                }
+            } else {
+                while (k & 1) {
+                    k >>= 1;
+                }
+                k >>= 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Rearrange sorted keys into Eytzinger order
+     * 
+     * @param keys - count Key elements in ascending order, replaced with Eytzinger order
+     * @param scratch - scratch space for count Key elements
+     * @param count - number of elements
+     */
+    inline void sortedToEytzinger(Key *keys, Key *scratch, std::size_t count)
+    {
+        std::copy(keys, keys + count, scratch);
+        std::size_t i = 0;
+        eytzingerInOrder(count, [&] (std::size_t pos) { keys[pos] = scratch[i++]; });
+    }
+
+    /**
+     * @brief Rearrange Eytzinger ordered keys into ascending order
+     * 
+     * @param keys - count Key elements in Eytzinger order, replaced with ascending order
+     * @param scratch - scratch space for count Key elements
+     * @param count - number of elements
+     */
+    inline void eytzingerToSorted(Key *keys, Key *scratch, std::size_t count)
+    {
+        std::copy(keys, keys + count, scratch);
+        std::size_t i = 0;
+        eytzingerInOrder(count, [&] (std::size_t pos) { keys[i++] = scratch[pos]; });
+    }
+
+    /**
+     * @brief branchless search of Eytzinger ordered keys.  Each step picks the left or right
+     *        child arithmetically and the keys several levels down are prefetched.  Keys are 
+     *        loaded with memcpy() so the keys need not be aligned.
+     * 
+     * @param keys - first of count Key elements in Eytzinger order
+     * @param count - number of elements
+     * @param key - key value to search for
+     * @return std::size_t - position of the Key element matching the key value or count if not found
+     */
+    inline std::size_t eytzingerSearch(const char *keys, std::size_t count, const uint32_t key)
+    {
+        std::size_t k = 1;
+        while (k <= count) {
+#if defined(__GNUC__) || defined(__clang__)
+            if (k * 16 <= count) {
+                __builtin_prefetch(keys + (k * 16 - 1) * sizeof(Key));
+            }
+#endif
+            uint32_t probe;
+            memcpy(&probe, keys + (k - 1) * sizeof(Key) + offsetof(Key, m_key), sizeof(probe));
+            k = 2 * k + static_cast<std::size_t>(probe < key);
+        }
+        // Undo the trailing right turns to land on the lower bound (0 if every key is lower)
+        while (k & 1) {
+            k >>= 1;
+        }
+        k >>= 1;
+        if (k != 0) {
+            uint32_t probe;
+            memcpy(&probe, keys + (k - 1) * sizeof(Key) + offsetof(Key, m_key), sizeof(probe));
+            if (probe == key) {
+                return k - 1;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief Location of the keys and values within a serialized Dict
+     */
+    struct WireFormat {
+        std::size_t m_count;
+        std::size_t m_keysOffset;
+        std::size_t m_valuesOffset;
+        uint8_t m_layout;
+    };
+
+    /**
+     * @brief Validate a serialized Dict (compact or legacy form) and locate its keys and values.
+     *        Keys must be in ascending (or valid Eytzinger) order with indices within the 
+     *        element count.
+     * 
+     * @tparam Value - value type
+     * @tparam N - capacity of the Dict<Value,N> whose legacy form is accepted
+     * @param buf - buffer containing the serialized Dict
+     * @param size - buffer size
+     * @param maxCount - maximum number of elements accepted in the compact form
+     * @return WireFormat - location of the keys and values.
+     *                      throws std::runtime_error if the buffer is not a valid Dict<Value,N>
+     */
+    template<class Value, std::size_t N>
+    WireFormat parseWire(const char *buf, size_t size, std::size_t maxCount = N)
+    {
+        constexpr std::size_t legacySize = sizeof(size_t) + sizeof(std::array<Key,N>) + sizeof(std::array<Value,N>);
+        WireFormat format;
+        WireHeader header;
+        bool compact = false;
+        if (size >= sizeof(header)) {
+            memcpy(&header, buf, sizeof(header));
+            compact = (header.m_magic == WIRE_MAGIC);
+        }
+        if (compact) {
+            if ((header.m_version != WIRE_VERSION && header.m_version != WIRE_VERSION_BYTE_HASH) ||
+                header.m_valueSize != sizeof(Value) || 
+                (header.m_layout != WIRE_LAYOUT_SORTED && header.m_layout != WIRE_LAYOUT_EYTZINGER)) {
+                throw std::runtime_error("Unsupported buffer format");
+            }
+            if (header.m_count > maxCount) {
+                throw std::runtime_error("Invalid buffer content");
+            }
+            format.m_count = header.m_count;
+            format.m_keysOffset = sizeof(header);
+            format.m_valuesOffset = sizeof(header) + format.m_count * sizeof(Key);
+            format.m_layout = header.m_layout;
+            if (size != format.m_valuesOffset + format.m_count * sizeof(Value)) {
+                throw std::runtime_error("Invalid buffer size");
+            }
+        } else if (size == legacySize) {
+            size_t count = 0;
+            memcpy(&count, buf, sizeof(count));
+            if (count > N) {
+                throw std::runtime_error("Invalid buffer content");
+            }
+            format.m_count = count;
+            format.m_keysOffset = sizeof(size_t);
+            format.m_valuesOffset = sizeof(size_t) + sizeof(std::array<Key,N>);
+            format.m_layout = WIRE_LAYOUT_SORTED;
+        } else {
+            throw std::runtime_error("Invalid buffer size");
+        }
+        Key prev;
+        std::size_t i = 0;
+        auto validate = [&] (std::size_t pos) {
+            Key key;
+            memcpy(&key, buf + format.m_keysOffset + pos * sizeof(Key), sizeof(Key));
+            if (key.m_index >= format.m_count) {
+                throw std::runtime_error("Invalid key index value");
+            }
+            if (i++ > 0 && !(prev.m_key < key.m_key)) {
+                throw std::runtime_error("Invalid key order");
+            }
+            prev = key;
+        };
+        if (format.m_layout == WIRE_LAYOUT_EYTZINGER) {
+            eytzingerInOrder(format.m_count, validate);
+        } else {
+            for (std::size_t pos = 0; pos < format.m_count; pos++) {
+                validate(pos);
+            }
+        }
+        return format;
+    }
+
+    /**
+     * @brief FNV-1a style hash of a serialized key array, taken a 32-bit word at a time, stored
+     *        in WireHeader::m_keysHash
+     * 
+     * @param keys - first of count Key elements
+     * @param count - number of elements
+     * @return uint32_t - hash of the keys and their value indices
+     */
+    inline uint32_t wireKeysHash(const char *keys, std::size_t count)
+    {
+        uint32_t hash = 2166136261u;
+        for (std::size_t i = 0; i < count * sizeof(Key); i += sizeof(uint32_t)) {
+            uint32_t word;
+            memcpy(&word, keys + i, sizeof(word));
+            hash ^= word;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Write the compact serialized form of a set of keys and values
+     * 
+     * @tparam Value - value type
+     * @param out - string receiving the serialized Dict
+     * @param keys - first of count Key elements in search order
+     * @param values - first of count values
+     * @param count - number of elements
+     * @param layout - key order, WIRE_LAYOUT_SORTED or WIRE_LAYOUT_EYTZINGER
+     */
+    template<class Value>
+    void writeWire(std::string &out, const char *keys, const char *values, std::size_t count,
+        uint8_t layout = WIRE_LAYOUT_SORTED)
+    {
+        WireHeader header;
+        header.m_magic = WIRE_MAGIC;
+        header.m_version = WIRE_VERSION;
+        header.m_layout = layout;
+        header.m_valueSize = static_cast<uint16_t>(sizeof(Value));
+        header.m_count = static_cast<uint32_t>(count);
+        header.m_keysHash = wireKeysHash(keys, count);
+        out.resize(sizeof(header) + count * (sizeof(Key) + sizeof(Value)));
+        char *buf = &out[0];
+        memcpy(buf, &header, sizeof(header));
+        memcpy(buf + sizeof(header), keys, count * sizeof(Key));
+        memcpy(buf + sizeof(header) + count * sizeof(Key), values, count * sizeof(Value));
+    }
+
+    /**
+     * @brief Search sorted keys, selecting scanKey() or findKey() at compile time from the 
+     *        maximum number of keys that can be searched
+     * 
+     * @tparam N - maximum number of keys
+     * @param first - pointer to first Key element
+     * @param last - pointer beyond the last Key element
+     * @param key - key value to search for
+     * @return const Key* - pointer to the desired Key element or last if not found
+     */
+    template<std::size_t N>
+    const Key* searchKeys(const Key *first, const Key *last, const uint32_t key)
+    {
+        if constexpr (DICT_SIMD_SEARCH && N <= SIMD_SCAN_MAX) {
+            return scanKey(first, last, key);
+        } else {
+            return findKey(first, last, key,
+                [] (const Key &elt, const uint32_t &key)
+                { return elt.m_key < key; });
+        }
+    }
+
+    /**
+     * @brief Insert a key/value pair into sorted keys and dense values with spare capacity for 
+     *        at least one more element.  The insertion point is found with one binary search
+     *        and the tail of the keys is shifted up by one.
+     * 
+     * @param keys - sorted Key elements
+     * @param values - values referenced by the keys
+     * @param size - number of elements, incremented on insertion
+     * @param key - 32-bit key
+     * @param value - value associated with the key
+     * @return true - key/value pair inserted
+     * @return false - key already present
+     */
+    template<class Value>
+    bool insertKey(Key *keys, Value *values, std::size_t &size, const uint32_t key, const Value &value)
+    {
+        Key *last = keys + size;
+        Key *i = std::lower_bound(keys, last, key,
+            [] (const Key &elt, const uint32_t &key)
+            { return elt.m_key < key; });
+        if (i != last && i->m_key == key) {
+            return false;
+        }
+        std::move_backward(i, last, last + 1);
+        i->m_key = key;
+        i->m_index = static_cast<uint32_t>(size);
+        values[size] = value;
+        size++;
+        return true;
+    }
+
+    /**
+     * @brief Remove a key from sorted keys and dense values.  The last value is moved into the
+     *        freed slot and the key that referenced it is updated.
+     * 
+     * @param keys - sorted Key elements
+     * @param values - values referenced by the keys
+     * @param size - number of elements, decremented on removal
+     * @param pos - Key element to be removed
+     */
+    template<class Value>
+    void eraseKey(Key *keys, Value *values, std::size_t &size, Key *pos)
+    {
+        const uint32_t freed = pos->m_index;
+        const uint32_t last = static_cast<uint32_t>(size - 1);
+        std::move(pos + 1, keys + size, pos);
+        size--;
+        if (freed != last) {
+            values[freed] = std::move(values[last]);
+            for (Key *k = keys; k != keys + size; ++k) {
+                if (k->m_index == last) {
+                    k->m_index = freed;
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Remove every key/value pair matching a predicate from sorted keys and dense values
+     *        in a single compaction pass
+     * 
+     * @param keys - sorted Key elements
+     * @param values - values referenced by the keys
+     * @param size - number of elements, reduced by the number removed
+     * @param remap - scratch space for at least size indices
+     * @param pred - predicate invoked as pred(uint32_t key, const Value &value)
+     * @return std::size_t - number of key/value pairs removed
+     */
+    template<class Value, class Pred>
+    std::size_t eraseKeysIf(Key *keys, Value *values, std::size_t &size, uint32_t *remap, Pred pred)
+    {
+        constexpr uint32_t removedSlot = UINT32_MAX;
+        // Compact the keys in place, recording which value slots are kept
+        std::fill(remap, remap + size, removedSlot);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            const Key key = keys[i];
+            if (!pred(key.m_key, static_cast<const Value&>(values[key.m_index]))) {
+                remap[key.m_index] = 0;
+                keys[kept++] = key;
+            }
+        }
+        const std::size_t removed = size - kept;
+        if (removed == 0) {
+            return 0;
+        }
+        // Slide kept values down over the removed slots and fix up the key indices
+        std::size_t next = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            if (remap[i] != removedSlot) {
+                if (next != i) {
+                    values[next] = std::move(values[i]);
+                }
+                remap[i] = static_cast<uint32_t>(next++);
+            }
+        }
+        size = kept;
+        for (Key *k = keys; k != keys + size; ++k) {
+            k->m_index = remap[k->m_index];
+        }
+        return removed;
+    }
+
     /**
      * @brief The Dict class implements a "flat" key/value dictionary
      * 
      * @tparam N - maximum number of elements in the dictionary
+     * @tparam Layout - key layout policy, SortedLayout or EytzingerLayout
      */
-    template<class Value, std::size_t N>
+    template<class Value, std::size_t N, class Layout = SortedLayout>
     class Dict {
     public:
+        static_assert(std::is_same<Layout, SortedLayout>::value || std::is_same<Layout, EytzingerLayout>::value,
+            "Unsupported Dict layout policy");
+
         // Type aliases
         using KeyType = std::array<Key,N>;
         using ValueType = std::array<Value,N>;
@@ -56,7 +537,7 @@ namespace dict {
         /**
          * @brief Default constructor
          */
-        Dict(): m_size(0)
+        Dict(): m_size(0), m_layout(WIRE_LAYOUT_SORTED), m_reshaped(true)
         {}
 
         /**
@@ -72,38 +553,159 @@ namespace dict {
         Dict(const Dict &rhs):
             m_size(rhs.m_size),
             m_keys(rhs.m_keys),
-            m_values(rhs.m_values)
+            m_values(rhs.m_values),
+            m_layout(rhs.m_layout),
+            m_dirty(rhs.m_dirty),
+            m_reshaped(rhs.m_reshaped)
         {}
 
-        Dict(const char *buf, size_t size) {
+        Dict(const char *buf, size_t size): m_size(0), m_layout(WIRE_LAYOUT_SORTED), m_reshaped(true) {
 
             refresh(buf, size);
 
         }
 
+        /**
+         * @brief Replace the Dict contents from a serialized Dict in either the compact or the 
+         *        legacy fixed-size form.  throws std::runtime_error if the buffer is invalid
+         * 
+         * @param buf - buffer containing the serialized Dict
+         * @param size - buffer size
+         */
         void refresh(const char *buf, size_t size) {
-            // Validate that the buffer size parameter matches this 
-            // class size
-            if (size != sizeof(*this)) {
-                throw std::runtime_error("Invalid buffer size");
+            auto format = parseWire<Value,N>(buf, size);
+            memcpy(m_keys.data(), buf + format.m_keysOffset, format.m_count * sizeof(Key));
+            memcpy(m_values.data(), buf + format.m_valuesOffset, format.m_count * sizeof(Value));
+            m_size = format.m_count;
+            m_layout = format.m_layout;
+            // An Eytzinger ordered buffer is used as is by an EytzingerLayout Dict
+            if constexpr (std::is_same<Layout, SortedLayout>::value) {
+                thaw();
             }
-            // Set m_size from the buffer
-            m_size = *(reinterpret_cast<const size_t*>(buf));
-            // Validate that the buffer's m_size is within the Dict
-            // capacity
-            if (m_size > N) {
-                throw std::runtime_error("Invalid buffer content");
+            // Contents now match the serialized form, unless it had to be re-sorted
+            m_dirty.reset();
+            m_reshaped = (m_layout != format.m_layout);
+        }
+
+        /**
+         * @brief return the size of the compact serialized form, proportional to the number of elements
+         * 
+         * @return size_t - serialized size
+         */
+        size_t serialized_size() const {
+            return sizeof(WireHeader) + m_size * (sizeof(Key) + sizeof(Value));
+        }
+
+        /**
+         * @brief write the compact serialized form (header followed by the keys and values in use)
+         * 
+         * @param out - string receiving the serialized Dict
+         */
+        void serialize(std::string &out) const {
+            writeWire<Value>(out, reinterpret_cast<const char*>(m_keys.data()), 
+                reinterpret_cast<const char*>(m_values.data()), m_size, m_layout);
+        }
+
+        /**
+         * @brief Rearrange the keys into the search-optimized order of the layout policy.  This
+         *        is a no-op for SortedLayout.  Mutating an EytzingerLayout Dict after freeze()
+         *        thaws it back to sorted order first, so freeze() once loading is complete.
+         */
+        void freeze() {
+            if constexpr (std::is_same<Layout, EytzingerLayout>::value) {
+                if (m_layout != WIRE_LAYOUT_EYTZINGER) {
+                    KeyType scratch;
+                    sortedToEytzinger(m_keys.data(), scratch.data(), m_size);
+                    m_layout = WIRE_LAYOUT_EYTZINGER;
+                    m_reshaped = true;
+                }
+            }
+        }
+
+        /**
+         * @brief Return the keys to ascending order
+         */
+        void thaw() {
+            if (m_layout != WIRE_LAYOUT_SORTED) {
+                KeyType scratch;
+                eytzingerToSorted(m_keys.data(), scratch.data(), m_size);
+                m_layout = WIRE_LAYOUT_SORTED;
+                m_reshaped = true;
             }
-            // Copy buffer's keys into m_keys
-            memcpy(m_keys.data(),buf+8,sizeof(m_keys));
-            // Validate indices for each key
-            for(const auto &key: m_keys) {
-                if (key.m_index > m_size) {
-                    throw std::runtime_error("Invalid key index value");
+        }
+
+        /**
+         * @brief Return indication of whether the keys are in the frozen (Eytzinger) order
+         */
+        bool frozen() const {
+            return m_layout != WIRE_LAYOUT_SORTED;
+        }
+
+        /**
+         * @brief Return indication of whether keys were added, removed or reordered since the
+         *        Dict was last refreshed or clean()ed, requiring the full serialized form to be 
+         *        written rather than patched
+         */
+        bool reshaped() const {
+            return m_reshaped;
+        }
+
+        /**
+         * @brief return the value slots changed by set(), or handed out for change by the
+         *        mutable at(), since the Dict was last refreshed or clean()ed
+         * 
+         * @return const std::bitset<N>& - bit set for each changed value slot
+         */
+        const std::bitset<N> &dirty() const {
+            return m_dirty;
+        }
+
+        /**
+         * @brief mark the Dict as matching its stored serialized form
+         */
+        void clean() {
+            m_dirty.reset();
+            m_reshaped = false;
+        }
+
+        /**
+         * @brief return the offset of a value slot within the compact serialized form
+         * 
+         * @param slot - value slot (Key::m_index)
+         * @return std::size_t - byte offset
+         */
+        std::size_t value_offset(std::size_t slot) const {
+            return sizeof(WireHeader) + m_size * sizeof(Key) + slot * sizeof(Value);
+        }
+
+        /**
+         * @brief return the hash of the keys stored in WireHeader::m_keysHash
+         */
+        uint32_t keys_hash() const {
+            return wireKeysHash(reinterpret_cast<const char*>(m_keys.data()), m_size);
+        }
+
+        /**
+         * @brief Visit each run of adjacent dirty value slots as a byte range of the compact
+         *        serialized form
+         * 
+         * @param patch - invoked as patch(std::size_t offset, const char *bytes, std::size_t length)
+         */
+        template<class Patch>
+        void for_each_dirty_range(Patch patch) const {
+            std::size_t slot = 0;
+            while (slot < m_size) {
+                if (!m_dirty[slot]) {
+                    slot++;
+                    continue;
                 }
+                std::size_t last = slot;
+                while (last + 1 < m_size && m_dirty[last + 1]) {
+                    last++;
+                }
+                patch(value_offset(slot), reinterpret_cast<const char*>(&m_values[slot]), (last - slot + 1) * sizeof(Value));
+                slot = last + 1;
             }
-            // Copy buffer's values into m_values
-            memcpy(m_values.data(),buf+8+sizeof(m_keys), sizeof(m_values));
         }
 
         /**
@@ -117,6 +719,9 @@ namespace dict {
                 m_keys = rhs.m_keys;
                 m_values = rhs.m_values;
                 m_size = rhs.m_size;
+                m_layout = rhs.m_layout;
+                m_dirty = rhs.m_dirty;
+                m_reshaped = rhs.m_reshaped;
             }
             return *this;
         }
@@ -125,9 +730,10 @@ namespace dict {
          * @brief clear the Dict contents
          */
         void clear() {
-            m_keys.clear();
-            m_values.clear();
             m_size = 0;
+            m_layout = WIRE_LAYOUT_SORTED;
+            m_dirty.reset();
+            m_reshaped = true;
         }
 
         /**
@@ -149,25 +755,27 @@ namespace dict {
         }
 
         /**
-         * @brief return a pointer to the Dict's contiguous data
+         * @brief return a pointer to the Dict's contiguous data (legacy fixed-size serialized form)
          * 
          * @return const uint8_t* - buffer pointer
          */
         const char *data() const {
+            static_assert(std::is_same<Layout, SortedLayout>::value, "Legacy form requires sorted keys");
             return reinterpret_cast<const char*>(&m_size);
         }
 
         /**
-         * @brief return the Dict's in-memory size
+         * @brief return the size of the Dict's contiguous data (legacy fixed-size serialized form)
          * 
          * @return size_t - container size
          */
         size_t container_size() const {
-            return sizeof(*this);
+            return sizeof(m_size) + sizeof(m_keys) + sizeof(m_values);
         }
 
         /**
-         * @brief return an iterator pointing to the first key
+         * @brief return an iterator pointing to the first key.  Keys are visited in ascending
+         *        order unless the Dict is frozen()
          * 
          * @return KeyType::iterator 
          */
@@ -184,6 +792,25 @@ namespace dict {
             return m_keys.begin() + m_size;
         }
 
+        /**
+         * @brief return a const iterator pointing to the first key, so that a const Dict can be
+         *        visited with a range-based for loop
+         * 
+         * @return KeyType::const_iterator 
+         */
+        typename KeyType::const_iterator begin() const {
+            return m_keys.cbegin();
+        }
+
+        /**
+         * @brief return a const iterator pointing just beyond the last key
+         * 
+         * @return KeyType::const_iterator 
+         */
+        typename KeyType::const_iterator end() const {
+            return m_keys.cbegin() + m_size;
+        }
+
         /**
          * @brief return a const iterator pointing to the first key
          * 
@@ -215,20 +842,84 @@ namespace dict {
             if (m_size == m_keys.size()) {
                 return false;
             }
-            if (!contains(key))
-            {
-                m_keys[m_size].m_key = key;
-                m_keys[m_size].m_index = static_cast<uint32_t>(m_size);
-                m_values[m_size] = value;
-                m_size++;
-                std::sort(&m_keys[0], &m_keys[m_size], 
-                    [](const Key &a, const Key &b) 
-                    { return a.m_key < b.m_key; });
+            thaw();
+            if (insertKey(m_keys.data(), m_values.data(), m_size, key, value)) {
+                m_reshaped = true;
                 return true;
             }
             return false;
         }
 
+        /**
+         * @brief insert a batch of key/value pairs into the Dict.  The batch is sorted once 
+         *        and merged with the existing keys; nothing is inserted if the batch would
+         *        exceed the Dict capacity or contains a key that is duplicated within the 
+         *        batch or already present in the Dict
+         * 
+         * @tparam InputIt - iterator type whose elements provide key (first) and value (second)
+         * @param first - iterator pointed at first element of the batch
+         * @param last - iterator pointed beyond the last element of the batch
+         * @return true - all key/value pairs inserted into the Dict
+         * @return false - no key/value pairs inserted
+         */
+        template<class InputIt>
+        bool insert_range(InputIt first, InputIt last)
+        {
+            thaw();
+            // Stage the batch in the unused tail of the keys and values arrays
+            std::size_t count = m_size;
+            for (; first != last; ++first) {
+                if (count == N) {
+                    return false;
+                }
+                m_keys[count].m_key = first->first;
+                m_keys[count].m_index = static_cast<uint32_t>(count);
+                m_values[count] = first->second;
+                count++;
+            }
+            auto less = [] (const Key &a, const Key &b) 
+                { return a.m_key < b.m_key; };
+            Key *begin = &m_keys[0];
+            Key *mid = begin + m_size;
+            Key *end = begin + count;
+            std::sort(mid, end, less);
+            if (std::adjacent_find(mid, end, 
+                    [] (const Key &a, const Key &b) 
+                    { return a.m_key == b.m_key; }) != end) {
+                return false;
+            }
+            // Reject keys already present with a single linear pass over both sorted runs
+            for (Key *a = begin, *b = mid; a != mid && b != end; ) {
+                if (a->m_key < b->m_key) {
+                    ++a;
+                } else if (b->m_key < a->m_key) {
+                    ++b;
+                } else {
+                    return false;
+                }
+            }
+            std::inplace_merge(begin, mid, end, less);
+            m_size = count;
+            m_reshaped = true;
+            return true;
+        }
+
+        /**
+         * @brief replace the Dict contents with a batch of key/value pairs
+         * 
+         * @tparam InputIt - iterator type whose elements provide key (first) and value (second)
+         * @param first - iterator pointed at first element of the batch
+         * @param last - iterator pointed beyond the last element of the batch
+         * @return true - Dict contents replaced by the batch
+         * @return false - batch rejected (see insert_range()), Dict is left empty
+         */
+        template<class InputIt>
+        bool assign(InputIt first, InputIt last)
+        {
+            clear();
+            return insert_range(first, last);
+        }
+
         /**
          * @brief update the value associated with a key/value pair already in the Dict
          * 
@@ -241,13 +932,55 @@ namespace dict {
         {
             auto i = find(key);
 
-            if (i != &m_keys[m_size]) {
+            if (i != keysEnd()) {
                 m_values.at(i->m_index) = value;
+                m_dirty.set(i->m_index);
                 return true;
             }
             return false;
         }
 
+        /**
+         * @brief remove a key/value pair from the Dict.  The last value is moved into the freed
+         *        slot so the values stay dense and the keys stay sorted without a re-sort.
+         * 
+         * @param key - 32-bit key
+         * @return true - key/value pair removed
+         * @return false - key not present
+         */
+        bool erase(const uint32_t key)
+        {
+            thaw();
+            Key *i = find(key);
+            if (i == keysEnd()) {
+                return false;
+            }
+            eraseKey(m_keys.data(), m_values.data(), m_size, i);
+            m_dirty.reset();
+            m_reshaped = true;
+            return true;
+        }
+
+        /**
+         * @brief remove every key/value pair matching a predicate in a single compaction pass
+         * 
+         * @tparam Pred - predicate type, invoked as pred(uint32_t key, const Value &value)
+         * @param pred - predicate returning true for pairs to be removed
+         * @return std::size_t - number of key/value pairs removed
+         */
+        template<class Pred>
+        std::size_t erase_if(Pred pred)
+        {
+            thaw();
+            std::array<uint32_t,N> remap;
+            std::size_t removed = eraseKeysIf(m_keys.data(), m_values.data(), m_size, remap.data(), pred);
+            if (removed) {
+                m_dirty.reset();
+                m_reshaped = true;
+            }
+            return removed;
+        }
+
         /**
          * @brief Return indication of whether a key/value pair is in the Dict
          * 
@@ -255,12 +988,14 @@ namespace dict {
          * @return true - key/value pair is present
          * @return false - key/value pair is not present
          */
-        bool contains(const uint32_t key) {
-            return (find(key) != &m_keys[m_size]);
+        bool contains(const uint32_t key) const {
+            return (find(key) != keysEnd());
         }
 
         /**
-         * @brief Return a reference to the value associated with a particular key
+         * @brief Return a reference to the value associated with a particular key.  The value
+         *        is marked dirty, since it may be changed through the reference: read through a
+         *        const Dict to leave it clean.
          * 
          * @param key - 32-bit key
          * @return Value& - value associated with this key.
@@ -269,23 +1004,32 @@ namespace dict {
         Value &at(const uint32_t key) {
             auto i = find(key);
 
-            if (i != &m_keys[m_size]) {
+            if (i != keysEnd()) {
+                m_dirty.set(i->m_index);
                 return m_values.at(i->m_index);
             }
             throw std::out_of_range("Key not found");
         }
 
         /**
-         * @brief Return a reference to the value associated with a particular key (range-based for loop)
+         * @brief Return a reference to the value associated with a particular key (range-based for loop).
+         *        A Key element of this Dict (as visited by begin()/end()) is resolved through its 
+         *        index without searching.  The value is marked dirty, as by at(uint32_t).
          * 
          * @param key - Key struct
          * @return Value& - value associated with this key.
          *                  throws std::out_of_range exception if key is not present
          */
         Value &at(const Key &key) {
+            std::less<const Key*> less;
+            if (!less(&key, m_keys.data()) && less(&key, keysEnd())) {
+                m_dirty.set(key.m_index);
+                return m_values[key.m_index];
+            }
             auto i = find(key.m_key);
 
-            if (i != &m_keys[m_size]) {
+            if (i != keysEnd()) {
+                m_dirty.set(i->m_index);
                 return m_values.at(i->m_index);
             }
             throw std::out_of_range("Key not found");            
@@ -301,28 +1045,154 @@ namespace dict {
         const Value &at(const uint32_t key) const {
             auto i = find(key);
 
-            if (i != &m_keys[m_size]) {
+            if (i != keysEnd()) {
                 return m_values.at(i->m_index);
             }
             throw std::out_of_range("Key not found");
         }
 
+        /**
+         * @brief Return a const reference to the value associated with a particular key (range-based
+         *        for loop over a const Dict).  Resolved like at(const Key&), without marking it dirty.
+         * 
+         * @param key - Key struct
+         * @return const Value& - const reference to value
+         *                        throws std::out_of_range exception if key is not present
+         */
+        const Value &at(const Key &key) const {
+            std::less<const Key*> less;
+            if (!less(&key, m_keys.data()) && less(&key, keysEnd())) {
+                return m_values[key.m_index];
+            }
+            return at(key.m_key);
+        }
+
+        /**
+         * @brief Return a pointer to the value associated with a key
+         * 
+         * @param key - 32-bit key
+         * @return const Value* - value associated with this key, or nullptr if not present
+         */
+        const Value *lookup(const uint32_t key) const {
+            auto i = find(key);
+            return (i != keysEnd()) ? &m_values[i->m_index] : nullptr;
+        }
+
+        /**
+         * @brief Resolve a batch of keys in one linear merge pass over the sorted keys.  Keys
+         *        are expected in ascending order; a key lower than its predecessor restarts the
+         *        merge with a binary search, so unsorted batches still resolve correctly.
+         * 
+         * @param keys - 32-bit keys to look up
+         * @param count - number of keys
+         * @param out - receives a pointer to the value for each key, or nullptr if not present
+         * @return std::size_t - number of keys found
+         */
+        std::size_t find_many(const uint32_t *keys, std::size_t count, const Value **out) const {
+            std::size_t found = 0;
+            mergeKeys(keys, count, [&] (std::size_t i, const Key *k) {
+                if (k) {
+                    out[i] = &m_values[k->m_index];
+                    found++;
+                } else {
+                    out[i] = nullptr;
+                }
+            });
+            return found;
+        }
+
+        /**
+         * @brief Copy the values for a batch of keys resolved in one linear merge pass (see 
+         *        find_many()), recording keys that are not present in a miss bitmap
+         * 
+         * @param keys - 32-bit keys to look up
+         * @param count - number of keys
+         * @param out - receives the value for each key present (left untouched for misses)
+         * @param misses - bitmap of (count + 63) / 64 words, bit i set if keys[i] is not present
+         * @return std::size_t - number of keys found
+         */
+        std::size_t at_many(const uint32_t *keys, std::size_t count, Value *out, uint64_t *misses) const {
+            std::fill(misses, misses + (count + 63) / 64, 0);
+            std::size_t found = 0;
+            mergeKeys(keys, count, [&] (std::size_t i, const Key *k) {
+                if (k) {
+                    out[i] = m_values[k->m_index];
+                    found++;
+                } else {
+                    misses[i / 64] |= (uint64_t(1) << (i % 64));
+                }
+            });
+            return found;
+        }
+
         /**
          * @note operator[] is not implemented to avoid "accidental" insertion of elements into the Dict
          */
 
     private:
         /**
-         * @brief Find a key in the ordered collection of keys
+         * @brief Find a key in the ordered collection of keys.  Small Dicts are searched with
+         *        a vectorized linear scan when the target ISA supports it, larger Dicts (or
+         *        builds without SIMD support) use the binary search, or the Eytzinger search
+         *        when frozen
          * 
          * @param key - key value to search for
-         * @return Key* - Key element matching the key value
+         * @return const Key* - Key element matching the key value or keysEnd() if not found
          */
+        const Key* find(const uint32_t key) const {
+            if constexpr (std::is_same<Layout, EytzingerLayout>::value && !(DICT_SIMD_SEARCH && N <= SIMD_SCAN_MAX)) {
+                if (m_layout == WIRE_LAYOUT_EYTZINGER) {
+                    return m_keys.data() + eytzingerSearch(reinterpret_cast<const char*>(m_keys.data()), m_size, key);
+                }
+            }
+            // The vectorized scan does not depend on key order
+            return searchKeys<N>(m_keys.data(), keysEnd(), key);
+        }
+
         Key* find(const uint32_t key) {
-            return findKey(&m_keys[0],&m_keys[m_size], key,
-                [] (Key &elt, const uint32_t &key)
-                { return elt.m_key < key; });
+            return const_cast<Key*>(static_cast<const Dict*>(this)->find(key));
         }
+
+        /**
+         * @brief Walk the sorted keys once for a batch of lookup keys
+         * 
+         * @param keys - 32-bit keys to look up, ideally ascending
+         * @param count - number of keys
+         * @param result - invoked as result(i, const Key*) with nullptr if keys[i] is not present
+         */
+        template<class Result>
+        void mergeKeys(const uint32_t *keys, std::size_t count, Result result) const {
+            if (frozen()) {
+                for (std::size_t i = 0; i < count; i++) {
+                    auto k = find(keys[i]);
+                    result(i, k != keysEnd() ? k : nullptr);
+                }
+                return;
+            }
+            const Key *first = m_keys.data();
+            const Key *last = keysEnd();
+            const Key *cursor = first;
+            for (std::size_t i = 0; i < count; i++) {
+                const uint32_t key = keys[i];
+                if (i > 0 && key < keys[i - 1]) {
+                    cursor = std::lower_bound(first, last, key,
+                        [] (const Key &elt, const uint32_t &key)
+                        { return elt.m_key < key; });
+                }
+                while (cursor != last && cursor->m_key < key) {
+                    ++cursor;
+                }
+                result(i, (cursor != last && cursor->m_key == key) ? cursor : nullptr);
+            }
+        }
+
+        /**
+         * @brief return a pointer just beyond the last key in use
+         */
+        const Key* keysEnd() const {
+            return m_keys.data() + m_size;
+        }
+
         /**
          * @brief Class members are expected to be a contiguous block of memory based on 
          *        std::array ContiguousContainer requirements
@@ -330,5 +1200,263 @@ namespace dict {
         size_t m_size;
         KeyType m_keys;
         ValueType m_values;
+        // Current key order, WIRE_LAYOUT_SORTED or WIRE_LAYOUT_EYTZINGER
+        uint8_t m_layout;
+        // Value slots changed by set() and whether keys changed since last refreshed/stored
+        std::bitset<N> m_dirty;
+        bool m_reshaped;
+    };
+    /**
+     * @brief The DictView class provides read-only access to a serialized Dict (compact or 
+     *        legacy form) directly from the buffer it was received in (e.g. a Redis reply) 
+     *        without copying the keys and values.  The buffer is validated once when the view is attached and must outlive
+     *        the view.  Buffers are not required to be aligned; unaligned buffers are read 
+     *        through memcpy() so values are returned by value rather than by reference.
+     *        Buffers serialized from a frozen EytzingerLayout Dict are searched in place and 
+     *        iterate in Eytzinger rather than ascending key order.
+     * 
+     * @tparam N - maximum number of elements in the dictionary
+     */
+    template<class Value, std::size_t N>
+    class DictView {
+    public:
+        static_assert(std::is_trivially_copyable<Value>::value, "DictView requires a trivially copyable Value");
+
+        /**
+         * @brief Iterator over the Keys in the view, yielding Key elements by value
+         */
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Key;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Key*;
+            using reference = Key;
+
+            const_iterator(const DictView *view, std::size_t pos): m_view(view), m_pos(pos)
+            {}
+
+            Key operator*() const {
+                return m_view->keyAt(m_pos);
+            }
+
+            const_iterator& operator++() {
+                ++m_pos;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator tmp(*this);
+                ++m_pos;
+                return tmp;
+            }
+
+            bool operator==(const const_iterator &rhs) const {
+                return m_pos == rhs.m_pos && m_view == rhs.m_view;
+            }
+
+            bool operator!=(const const_iterator &rhs) const {
+                return !(*this == rhs);
+            }
+
+        private:
+            const DictView *m_view;
+            std::size_t m_pos;
+        };
+
+        /**
+         * @brief Default constructor, creates an empty view
+         */
+        DictView(): m_buf(nullptr), m_bufSize(0), m_size(0), m_keysOffset(0), m_valuesOffset(0), 
+            m_layout(WIRE_LAYOUT_SORTED), m_aligned(false)
+        {}
+
+        /**
+         * @brief Construct a view over a serialized Dict
+         * 
+         * @param buf - buffer containing a serialized Dict<Value,N>
+         * @param size - buffer size
+         */
+        DictView(const char *buf, size_t size) {
+            refresh(buf, size);
+        }
+
+        /**
+         * @brief Attach the view to a serialized Dict in either the compact or the legacy 
+         *        fixed-size form, validating the buffer contents.
+         *        throws std::runtime_error if the buffer is not a valid Dict<Value,N>
+         * 
+         * @param buf - buffer containing a serialized Dict<Value,N>
+         * @param size - buffer size
+         */
+        void refresh(const char *buf, size_t size) {
+            auto format = parseWire<Value,N>(buf, size);
+            m_buf = buf;
+            m_bufSize = size;
+            m_size = format.m_count;
+            m_keysOffset = format.m_keysOffset;
+            m_valuesOffset = format.m_valuesOffset;
+            m_layout = format.m_layout;
+            m_aligned = (reinterpret_cast<std::uintptr_t>(buf + m_keysOffset) % alignof(Key)) == 0;
+        }
+
+        /**
+         * @brief return the current view size
+         * 
+         * @return std::size_t - number of elements
+         */
+        std::size_t size() const {
+            return m_size;
+        }
+
+        /**
+         * @brief return the view capacity
+         * 
+         * @return std::size_t - element capacity
+         */
+        std::size_t capacity() const {
+            return N;
+        }
+
+        /**
+         * @brief return a pointer to the underlying serialized Dict
+         * 
+         * @return const char* - buffer pointer
+         */
+        const char *data() const {
+            return m_buf;
+        }
+
+        /**
+         * @brief return the size of the underlying serialized Dict
+         * 
+         * @return size_t - buffer size
+         */
+        size_t container_size() const {
+            return m_bufSize;
+        }
+
+        /**
+         * @brief return the size of the compact serialized form of the viewed Dict
+         * 
+         * @return size_t - serialized size
+         */
+        size_t serialized_size() const {
+            return sizeof(WireHeader) + m_size * (sizeof(Key) + sizeof(Value));
+        }
+
+        /**
+         * @brief write the compact serialized form of the viewed Dict
+         * 
+         * @param out - string receiving the serialized Dict
+         */
+        void serialize(std::string &out) const {
+            writeWire<Value>(out, m_buf + m_keysOffset, m_buf + m_valuesOffset, m_size, m_layout);
+        }
+
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const {
+            return const_iterator(this, m_size);
+        }
+
+        const_iterator cbegin() const {
+            return begin();
+        }
+
+        const_iterator cend() const {
+            return end();
+        }
+
+        /**
+         * @brief Return indication of whether a key/value pair is in the view
+         * 
+         * @param key - 32-bit key
+         * @return true - key/value pair is present
+         * @return false - key/value pair is not present
+         */
+        bool contains(const uint32_t key) const {
+            return find(key) != m_size;
+        }
+
+        /**
+         * @brief Return a copy of the value associated with a particular key
+         * 
+         * @param key - 32-bit key
+         * @return Value - value associated with this key.
+         *                 throws std::out_of_range exception if key is not present
+         */
+        Value at(const uint32_t key) const {
+            auto i = find(key);
+
+            if (i != m_size) {
+                return valueAt(keyAt(i).m_index);
+            }
+            throw std::out_of_range("Key not found");
+        }
+
+        /**
+         * @brief Return a copy of the value associated with a particular key (range-based for loop)
+         * 
+         * @param key - Key struct
+         * @return Value - value associated with this key
+         */
+        Value at(const Key &key) const {
+            if (key.m_index < m_size) {
+                return valueAt(key.m_index);
+            }
+            throw std::out_of_range("Key not found");
+        }
+
+        /**
+         * @brief Find a key in the view
+         * 
+         * @param key - key value to search for
+         * @return std::size_t - position of the Key element matching the key value or size() if not found
+         */
+        std::size_t find(const uint32_t key) const {
+            if (m_layout == WIRE_LAYOUT_EYTZINGER && !(m_aligned && DICT_SIMD_SEARCH && N <= SIMD_SCAN_MAX)) {
+                return eytzingerSearch(m_buf + m_keysOffset, m_size, key);
+            }
+            if (m_aligned) {
+                const Key *first = reinterpret_cast<const Key*>(m_buf + m_keysOffset);
+                return static_cast<std::size_t>(searchKeys<N>(first, first + m_size, key) - first);
+            }
+            // Unaligned buffer: binary search loading each probed key with memcpy()
+            std::size_t lo = 0;
+            std::size_t hi = m_size;
+            while (lo < hi) {
+                std::size_t mid = lo + (hi - lo) / 2;
+                if (keyAt(mid).m_key < key) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return (lo != m_size && keyAt(lo).m_key == key) ? lo : m_size;
+        }
+
+    private:
+        Key keyAt(std::size_t pos) const {
+            Key key;
+            memcpy(&key, m_buf + m_keysOffset + pos * sizeof(Key), sizeof(Key));
+            return key;
+        }
+
+        Value valueAt(std::size_t pos) const {
+            Value value;
+            memcpy(&value, m_buf + m_valuesOffset + pos * sizeof(Value), sizeof(Value));
+            return value;
+        }
+
+        const char *m_buf;
+        size_t m_bufSize;
+        size_t m_size;
+        size_t m_keysOffset;
+        size_t m_valuesOffset;
+        uint8_t m_layout;
+        bool m_aligned;
     };
 }
\ No newline at end of file
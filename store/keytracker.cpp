@@ -0,0 +1,137 @@
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <spdlog/spdlog.h>
+#include "keytracker.h"
+
+// Keyspace notifications of every database, channel "__keyspace@<db>__:<key>"
+static const char *KEYSPACE_PATTERN = "__keyspace@*__:*";
+
+static const auto RESUBSCRIBE_DELAY = std::chrono::milliseconds(500);
+
+// Delay before checking the server configuration again after it was found lacking
+static const int RECHECK_DELAYS = 20;
+
+KeyTracker::KeyTracker(std::shared_ptr<sw::redis::Redis> redis, std::shared_ptr<spdlog::logger> logger):
+    m_redis(redis),
+    m_logger(logger),
+    m_generations(new std::atomic<uint64_t>[STRIPES]()),
+    m_invalidations(0),
+    m_active(false),
+    m_stopChannel(fmt::format("__store_tracker__:{}:{}", getpid(), static_cast<const void*>(this))),
+    m_running(true),
+    m_stopped(false),
+    m_subscriber(std::thread(&KeyTracker::run, this))
+{
+
+}
+
+KeyTracker::~KeyTracker()
+{
+    m_running = false;
+    // Keep waking the subscriber in case it was still subscribing when first published to
+    while (!m_stopped.load()) {
+        try {
+            m_redis->publish(m_stopChannel, "stop");
+        } catch (const sw::redis::Error &e) {
+            m_logger->error("Caught Redis exception {}", e.what());
+        }
+        std::this_thread::sleep_for(RESUBSCRIBE_DELAY / 10);
+    }
+    if (m_subscriber.joinable()) {
+        m_subscriber.join();
+    }
+}
+
+uint64_t KeyTracker::stamp(const std::string &key) const
+{
+    return m_generations[std::hash<std::string>()(key) % STRIPES].load(std::memory_order_acquire);
+}
+
+void KeyTracker::run()
+{
+    m_logger->info("Starting KeyTracker thread");
+
+    while (m_running.load()) {
+        int delays = 1;
+        try {
+            if (!checkConfig()) {
+                delays = RECHECK_DELAYS;
+            } else {
+                auto subscriber = m_redis->subscriber();
+                subscriber.on_pmessage([this] (std::string, std::string channel, std::string) {
+                    invalidate(channel);
+                });
+                subscriber.on_message([] (std::string, std::string) {});
+                subscriber.on_meta([this] (sw::redis::Subscriber::MsgType type, sw::redis::OptionalString, long long) {
+                    if (type == sw::redis::Subscriber::MsgType::PSUBSCRIBE) {
+                        // Anything cached before the subscription took effect is suspect
+                        invalidateAll();
+                        m_active.store(true, std::memory_order_release);
+                        m_logger->info("KeyTracker subscribed to keyspace notifications");
+                    }
+                });
+                subscriber.subscribe(m_stopChannel);
+                subscriber.psubscribe(KEYSPACE_PATTERN);
+
+                while (m_running.load()) {
+                    try {
+                        subscriber.consume();
+                    } catch (const sw::redis::TimeoutError &) {
+                        continue;
+                    }
+                }
+            }
+        } catch (const sw::redis::Error &e) {
+            m_logger->error("KeyTracker::run() Exception {}", e.what());
+        }
+        // Notifications may have been missed while the subscription was down
+        m_active.store(false, std::memory_order_release);
+        invalidateAll();
+        for (int i = 0; i < delays && m_running.load(); i++) {
+            std::this_thread::sleep_for(RESUBSCRIBE_DELAY);
+        }
+    }
+    m_logger->info("Exiting KeyTracker thread");
+    m_stopped = true;
+}
+
+bool KeyTracker::checkConfig()
+{
+    std::vector<std::string> config;
+    try {
+        config = m_redis->command<std::vector<std::string>>("CONFIG", "GET", "notify-keyspace-events");
+    } catch (const sw::redis::ReplyError &e) {
+        // Managed servers often disable CONFIG, trust the operator who enabled tracking
+        m_logger->warn("KeyTracker unable to read notify-keyspace-events ({}), assuming it is set", e.what());
+        return true;
+    }
+    std::string events = config.size() == 2 ? config[1] : "";
+    auto has = [&events] (char flag) {
+        return events.find(flag) != std::string::npos;
+    };
+    if (!has('K') || !(has('A') || (has('h') && has('g') && has('x') && has('e')))) {
+        m_logger->error("KeyTracker needs notify-keyspace-events \"KA\" (or K with h, g, x and e), server has \"{}\"",
+                        events);
+        return false;
+    }
+    return true;
+}
+
+void KeyTracker::invalidate(const std::string &channel)
+{
+    auto pos = channel.find("__:");
+    if (pos == std::string::npos) {
+        return;
+    }
+    std::string key = channel.substr(pos + 3);
+    m_generations[std::hash<std::string>()(key) % STRIPES].fetch_add(1, std::memory_order_acq_rel);
+    m_invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeyTracker::invalidateAll()
+{
+    for (std::size_t i = 0; i < STRIPES; i++) {
+        m_generations[i].fetch_add(1, std::memory_order_acq_rel);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sw/redis++/redis++.h>
+
+namespace spdlog {
+    class logger;
+}
+
+/**
+ * @brief The KeyTracker class follows Redis keyspace notifications on a dedicated subscriber
+ *        connection to tell whether a locally cached copy of a key may still be served.
+ *
+ *        Keys hash onto striped generation counters which are bumped whenever a notification
+ *        for the key arrives.  A caller takes stamp(key) *before* reading or writing the key in
+ *        Redis and keeps it with the cached copy; the copy is valid while the stamp still matches.
+ *        Unrelated keys sharing a stripe only cause extra refetches.  Every stripe is bumped when
+ *        the subscription is lost or (re)established, as notifications may have been missed.
+ *
+ *        Requires notify-keyspace-events to include keyspace events (K) for hash and generic
+ *        commands, expiry and eviction, e.g. "KA".
+ */
+class KeyTracker {
+public:
+    static constexpr std::size_t STRIPES = 4096;
+
+    KeyTracker(std::shared_ptr<sw::redis::Redis> redis, std::shared_ptr<spdlog::logger> logger);
+
+    ~KeyTracker();
+
+    KeyTracker(const KeyTracker &) = delete;
+    KeyTracker& operator=(const KeyTracker &) = delete;
+
+    /**
+     * @brief Return indication of whether the keyspace subscription is established
+     */
+    bool active() const {
+        return m_active.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Return the current generation of a key
+     *
+     * @param key - Redis key
+     * @return uint64_t - stamp to keep with a copy of the key read or written from now on
+     */
+    uint64_t stamp(const std::string &key) const;
+
+    /**
+     * @brief Return indication of whether a copy stamped with stamp() may be served locally
+     *
+     * @param key - Redis key
+     * @param stamp - stamp taken before the copy was read or written
+     * @return true - no notification for the key has arrived since the stamp was taken
+     * @return false - the copy must be refetched
+     */
+    bool valid(const std::string &key, uint64_t stamp) const {
+        return active() && stamp == this->stamp(key);
+    }
+
+    /**
+     * @brief Return the number of keyspace notifications received
+     */
+    uint64_t invalidations() const {
+        return m_invalidations.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run();
+
+    bool checkConfig();
+
+    void invalidate(const std::string &channel);
+
+    void invalidateAll();
+
+    std::shared_ptr<sw::redis::Redis> m_redis;
+    std::shared_ptr<spdlog::logger> m_logger;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_generations;
+    std::atomic<uint64_t> m_invalidations;
+    std::atomic_bool m_active;
+    // Private channel published to on shutdown to wake the subscriber
+    std::string m_stopChannel;
+    std::atomic_bool m_running;
+    std::atomic_bool m_stopped;
+    std::thread m_subscriber;
+};
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "flatdict.h"
+
+namespace dict {
+
+    /**
+     * @brief The SmallDict class implements a "flat" key/value dictionary which keeps up to
+     *        InlineN elements inline and spills to heap-allocated sorted arrays beyond that.
+     *        It shares the lookup API and the compact serialized form of Dict, with the
+     *        serialized count recording the real number of elements.
+     *
+     * @tparam InlineN - number of elements stored inline before spilling to the heap
+     */
+    template<class Value, std::size_t InlineN>
+    class SmallDict {
+    public:
+        /**
+         * @brief Default constructor
+         */
+        SmallDict(): m_size(0), m_capacity(InlineN)
+        {}
+
+        /**
+         * @brief Destructor
+         */
+        ~SmallDict() = default;
+
+        /**
+         * @brief Construct a new SmallDict object from a serialized Dict
+         *
+         * @param buf - buffer containing the serialized Dict
+         * @param size - buffer size
+         */
+        SmallDict(const char *buf, size_t size): SmallDict() {
+            refresh(buf, size);
+        }
+
+        /**
+         * @brief Copy constructor
+         *
+         * @param rhs - SmallDict to copy from
+         */
+        SmallDict(const SmallDict &rhs): SmallDict() {
+            *this = rhs;
+        }
+
+        /**
+         * @brief Move constructor
+         *
+         * @param rhs - SmallDict to move from
+         */
+        SmallDict(SmallDict &&rhs) noexcept: SmallDict() {
+            *this = std::move(rhs);
+        }
+
+        /**
+         * @brief Assignment operator
+         *
+         * @param rhs - SmallDict to copy from
+         * @return SmallDict& - reference to this SmallDict
+         */
+        SmallDict& operator=(const SmallDict &rhs) {
+            if (this != &rhs) {
+                m_size = 0;
+                reserve(rhs.m_size);
+                std::copy(rhs.keys(), rhs.keys() + rhs.m_size, keys());
+                std::copy(rhs.values(), rhs.values() + rhs.m_size, values());
+                m_size = rhs.m_size;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Move assignment operator
+         *
+         * @param rhs - SmallDict to move from, left empty
+         * @return SmallDict& - reference to this SmallDict
+         */
+        SmallDict& operator=(SmallDict &&rhs) noexcept {
+            if (this != &rhs) {
+                if (rhs.spilled()) {
+                    m_heapKeys = std::move(rhs.m_heapKeys);
+                    m_heapValues = std::move(rhs.m_heapValues);
+                    m_capacity = rhs.m_capacity;
+                } else {
+                    m_heapKeys.reset();
+                    m_heapValues.reset();
+                    m_capacity = InlineN;
+                    std::copy(rhs.m_inlineKeys.begin(), rhs.m_inlineKeys.begin() + rhs.m_size, m_inlineKeys.begin());
+                    std::move(rhs.m_inlineValues.begin(), rhs.m_inlineValues.begin() + rhs.m_size, m_inlineValues.begin());
+                }
+                m_size = rhs.m_size;
+                rhs.m_size = 0;
+                rhs.m_capacity = InlineN;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Replace the SmallDict contents from a serialized Dict in either the compact form
+         *        (any element count) or the legacy fixed-size form of a Dict<Value,InlineN>.
+         *        throws std::runtime_error if the buffer is invalid
+         *
+         * @param buf - buffer containing the serialized Dict
+         * @param size - buffer size
+         */
+        void refresh(const char *buf, size_t size) {
+            auto format = parseWire<Value,InlineN>(buf, size, UINT32_MAX);
+            m_size = 0;
+            reserve(format.m_count);
+            memcpy(keys(), buf + format.m_keysOffset, format.m_count * sizeof(Key));
+            memcpy(values(), buf + format.m_valuesOffset, format.m_count * sizeof(Value));
+            m_size = format.m_count;
+            if (format.m_layout == WIRE_LAYOUT_EYTZINGER) {
+                std::unique_ptr<Key[]> scratch(new Key[m_size]);
+                eytzingerToSorted(keys(), scratch.get(), m_size);
+            }
+        }
+
+        /**
+         * @brief return the size of the compact serialized form
+         *
+         * @return size_t - serialized size
+         */
+        size_t serialized_size() const {
+            return sizeof(WireHeader) + m_size * (sizeof(Key) + sizeof(Value));
+        }
+
+        /**
+         * @brief write the compact serialized form
+         *
+         * @param out - string receiving the serialized Dict
+         */
+        void serialize(std::string &out) const {
+            writeWire<Value>(out, reinterpret_cast<const char*>(keys()),
+                reinterpret_cast<const char*>(values()), m_size);
+        }
+
+        /**
+         * @brief clear the SmallDict contents, retaining any heap capacity
+         */
+        void clear() {
+            m_size = 0;
+        }
+
+        /**
+         * @brief return the current SmallDict size
+         *
+         * @return std::size_t - number of elements
+         */
+        std::size_t size() const {
+            return m_size;
+        }
+
+        /**
+         * @brief return the current SmallDict capacity
+         *
+         * @return std::size_t - element capacity before the next heap (re)allocation
+         */
+        std::size_t capacity() const {
+            return m_capacity;
+        }
+
+        /**
+         * @brief Return indication of whether the elements have spilled to the heap
+         */
+        bool spilled() const {
+            return static_cast<bool>(m_heapKeys);
+        }
+
+        /**
+         * @brief ensure capacity for at least count elements, spilling to the heap if needed
+         *
+         * @param count - number of elements
+         */
+        void reserve(std::size_t count) {
+            if (count <= m_capacity) {
+                return;
+            }
+            std::size_t capacity = std::max(count, m_capacity * 2);
+            std::unique_ptr<Key[]> heapKeys(new Key[capacity]);
+            std::unique_ptr<Value[]> heapValues(new Value[capacity]);
+            std::copy(keys(), keys() + m_size, heapKeys.get());
+            std::move(values(), values() + m_size, heapValues.get());
+            m_heapKeys = std::move(heapKeys);
+            m_heapValues = std::move(heapValues);
+            m_capacity = capacity;
+        }
+
+        /**
+         * @brief return a const iterator pointing to the first key
+         *
+         * @return const Key*
+         */
+        const Key* begin() const {
+            return keys();
+        }
+
+        /**
+         * @brief return a const iterator pointing just beyond the last key
+         *
+         * @return const Key*
+         */
+        const Key* end() const {
+            return keys() + m_size;
+        }
+
+        const Key* cbegin() const {
+            return begin();
+        }
+
+        const Key* cend() const {
+            return end();
+        }
+
+        /**
+         * @brief insert a key/value pair into the SmallDict, spilling to the heap when the
+         *        current capacity is exhausted
+         *
+         * @param key - 32-bit key
+         * @param value - value associated with the key
+         * @return true - key/value pair inserted into the SmallDict
+         * @return false - key already present
+         */
+        bool insert(const uint32_t &key, const Value &value)
+        {
+            if (m_size == m_capacity) {
+                if (contains(key)) {
+                    return false;
+                }
+                reserve(m_size + 1);
+            }
+            return insertKey(keys(), values(), m_size, key, value);
+        }
+
+        /**
+         * @brief update the value associated with a key/value pair already in the SmallDict
+         *
+         * @param key - 32-bit key
+         * @param value - updated value for the key
+         * @return true - key/value pair updated
+         * @return false - key/value pair not updated
+         */
+        bool set(const uint32_t &key, const Value &value)
+        {
+            auto i = find(key);
+
+            if (i != end()) {
+                values()[i->m_index] = value;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief remove a key/value pair from the SmallDict
+         *
+         * @param key - 32-bit key
+         * @return true - key/value pair removed
+         * @return false - key not present
+         */
+        bool erase(const uint32_t key)
+        {
+            auto i = find(key);
+            if (i == end()) {
+                return false;
+            }
+            eraseKey(keys(), values(), m_size, const_cast<Key*>(i));
+            return true;
+        }
+
+        /**
+         * @brief remove every key/value pair matching a predicate in a single compaction pass
+         *
+         * @tparam Pred - predicate type, invoked as pred(uint32_t key, const Value &value)
+         * @param pred - predicate returning true for pairs to be removed
+         * @return std::size_t - number of key/value pairs removed
+         */
+        template<class Pred>
+        std::size_t erase_if(Pred pred)
+        {
+            if (!spilled()) {
+                std::array<uint32_t,InlineN> remap;
+                return eraseKeysIf(keys(), values(), m_size, remap.data(), pred);
+            }
+            std::unique_ptr<uint32_t[]> remap(new uint32_t[m_size]);
+            return eraseKeysIf(keys(), values(), m_size, remap.get(), pred);
+        }
+
+        /**
+         * @brief Return indication of whether a key/value pair is in the SmallDict
+         *
+         * @param key - 32-bit key
+         * @return true - key/value pair is present
+         * @return false - key/value pair is not present
+         */
+        bool contains(const uint32_t key) const {
+            return (find(key) != end());
+        }
+
+        /**
+         * @brief Return a reference to the value associated with a particular key
+         *
+         * @param key - 32-bit key
+         * @return Value& - value associated with this key.
+         *                  throws std::out_of_range exception if key is not present
+         */
+        Value &at(const uint32_t key) {
+            return const_cast<Value&>(static_cast<const SmallDict*>(this)->at(key));
+        }
+
+        /**
+         * @brief Return a reference to the value associated with a particular key (range-based for loop)
+         *
+         * @param key - Key struct
+         * @return Value& - value associated with this key.
+         *                  throws std::out_of_range exception if key is not present
+         */
+        Value &at(const Key &key) {
+            return at(key.m_key);
+        }
+
+        /**
+         * @brief Return a const reference to the value associated with a key
+         *
+         * @param key - 32-bit key
+         * @return const Value& - const reference to value
+         *                        throws std::out_of_range exception if key is not present
+         */
+        const Value &at(const uint32_t key) const {
+            auto i = find(key);
+
+            if (i != end()) {
+                return values()[i->m_index];
+            }
+            throw std::out_of_range("Key not found");
+        }
+
+    private:
+        /**
+         * @brief Find a key, using the small Dict search while inline and the binary search
+         *        once spilled
+         *
+         * @param key - key value to search for
+         * @return const Key* - Key element matching the key value or end() if not found
+         */
+        const Key* find(const uint32_t key) const {
+            if (!spilled()) {
+                return searchKeys<InlineN>(keys(), end(), key);
+            }
+            return findKey(keys(), end(), key,
+                [] (const Key &elt, const uint32_t &key)
+                { return elt.m_key < key; });
+        }
+
+        Key* keys() {
+            return spilled() ? m_heapKeys.get() : m_inlineKeys.data();
+        }
+
+        const Key* keys() const {
+            return spilled() ? m_heapKeys.get() : m_inlineKeys.data();
+        }
+
+        Value* values() {
+            return spilled() ? m_heapValues.get() : m_inlineValues.data();
+        }
+
+        const Value* values() const {
+            return spilled() ? m_heapValues.get() : m_inlineValues.data();
+        }
+
+        std::size_t m_size;
+        std::size_t m_capacity;
+        std::array<Key,InlineN> m_inlineKeys;
+        std::array<Value,InlineN> m_inlineValues;
+        std::unique_ptr<Key[]> m_heapKeys;
+        std::unique_ptr<Value[]> m_heapValues;
+    };
+}
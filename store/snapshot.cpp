@@ -0,0 +1,283 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include "snapshot.h"
+
+static std::system_error fileError(const std::string &what, const std::string &path)
+{
+    return std::system_error(errno, std::generic_category(), what + " " + path);
+}
+
+static uint32_t rotateLeft(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+/**
+ * @brief Compute the SHA1 digest of a record, as redis.sha1hex() does server-side
+ */
+static void sha1(const char *data, std::size_t size, uint8_t digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    auto block = [&h] (const uint8_t *p) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = uint32_t(p[4 * i]) << 24 | uint32_t(p[4 * i + 1]) << 16 | uint32_t(p[4 * i + 2]) << 8 | p[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    };
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    std::size_t full = size - size % 64;
+    for (std::size_t offset = 0; offset < full; offset += 64) {
+        block(bytes + offset);
+    }
+    // Padding: a 1 bit, zeros, then the message length in bits, big-endian
+    uint8_t tail[128] = {};
+    std::size_t rest = size - full;
+    if (rest) {
+        memcpy(tail, bytes + full, rest);
+    }
+    tail[rest] = 0x80;
+    std::size_t tailSize = rest < 56 ? 64 : 128;
+    uint64_t bits = uint64_t(size) * 8;
+    for (std::size_t i = 0; i < 8; i++) {
+        tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    for (std::size_t offset = 0; offset < tailSize; offset += 64) {
+        block(tail + offset);
+    }
+    for (std::size_t i = 0; i < 20; i++) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &path):
+    m_path(path), m_tmpPath(path + ".tmp"), m_file(fopen(m_tmpPath.c_str(), "wb")), m_offset(0)
+{
+    if (!m_file) {
+        throw fileError("Unable to create", m_tmpPath);
+    }
+    // The header is written last, once the index offset is known
+    SnapshotHeader header = {};
+    append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (m_file) {
+        fclose(m_file);
+        unlink(m_tmpPath.c_str());
+    }
+}
+
+void SnapshotWriter::add(const std::string &key, Entry &entry)
+{
+    SnapshotIndex index = {};
+    index.m_keyOffset = append(key.data(), key.size());
+    index.m_keySize = static_cast<uint32_t>(key.size());
+    index.m_loaded = entry.loaded();
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (index.m_loaded & (RecordMask(1) << idx)) {
+            auto data = entry.data(idx);
+            index.m_records[idx].m_size = entry.size(idx);
+            index.m_records[idx].m_offset = append(data, entry.size(idx));
+            sha1(data, entry.size(idx), index.m_records[idx].m_digest);
+        }
+    }
+    m_index.push_back(index);
+}
+
+std::size_t SnapshotWriter::commit()
+{
+    SnapshotHeader header = {};
+    header.m_magic = SNAPSHOT_MAGIC;
+    header.m_version = SNAPSHOT_VERSION;
+    header.m_records = static_cast<uint16_t>(Entry::RECORDS);
+    header.m_valueSize = static_cast<uint32_t>(sizeof(Value));
+    header.m_count = m_index.size();
+    header.m_indexOffset = append(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(SnapshotIndex));
+    if (fseek(m_file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, m_file) != 1 ||
+        fflush(m_file) != 0 || fsync(fileno(m_file)) != 0) {
+        throw fileError("Unable to write", m_tmpPath);
+    }
+    fclose(m_file);
+    m_file = nullptr;
+    if (rename(m_tmpPath.c_str(), m_path.c_str()) != 0) {
+        auto error = fileError("Unable to rename to", m_path);
+        unlink(m_tmpPath.c_str());
+        throw error;
+    }
+    return m_index.size();
+}
+
+uint64_t SnapshotWriter::append(const char *data, std::size_t size)
+{
+    static const char padding[8] = {};
+    auto offset = m_offset;
+    std::size_t pad = (8 - size % 8) % 8;
+    if ((size && fwrite(data, size, 1, m_file) != 1) || (pad && fwrite(padding, pad, 1, m_file) != 1)) {
+        throw fileError("Unable to write", m_tmpPath);
+    }
+    m_offset += size + pad;
+    return offset;
+}
+
+std::shared_ptr<SnapshotFile> SnapshotFile::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw fileError("Unable to open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        auto error = fileError("Unable to stat", path);
+        close(fd);
+        throw error;
+    }
+    auto size = static_cast<std::size_t>(st.st_size);
+    void *data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED) {
+        auto error = size ? fileError("Unable to map", path) : std::system_error(EINVAL, std::generic_category(), "Empty snapshot " + path);
+        close(fd);
+        throw error;
+    }
+    // The mapping stays valid once the descriptor is closed
+    close(fd);
+    try {
+        return std::shared_ptr<SnapshotFile>(new SnapshotFile(static_cast<const char*>(data), size));
+    } catch (...) {
+        munmap(data, size);
+        throw;
+    }
+}
+
+SnapshotFile::SnapshotFile(const char *data, std::size_t size):
+    m_data(data), m_size(size), m_count(0), m_index(nullptr)
+{
+    SnapshotHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Invalid snapshot size");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.m_magic != SNAPSHOT_MAGIC || header.m_version != SNAPSHOT_VERSION ||
+        header.m_records != Entry::RECORDS || header.m_valueSize != sizeof(Value)) {
+        throw std::runtime_error("Unsupported snapshot format");
+    }
+    if (header.m_indexOffset > size || header.m_indexOffset % alignof(SnapshotIndex) != 0 ||
+        header.m_count > (size - header.m_indexOffset) / sizeof(SnapshotIndex)) {
+        throw std::runtime_error("Invalid snapshot index");
+    }
+    m_count = header.m_count;
+    m_index = reinterpret_cast<const SnapshotIndex*>(data + header.m_indexOffset);
+    // Only the index is read here, records are faulted in when loaded
+    for (std::size_t i = 0; i < m_count; i++) {
+        auto &entry = m_index[i];
+        bool valid = entry.m_keyOffset <= size && entry.m_keySize <= size - entry.m_keyOffset;
+        for (std::size_t idx = 0; valid && idx < Entry::RECORDS; idx++) {
+            auto &record = entry.m_records[idx];
+            valid = record.m_offset <= size && record.m_size <= size - record.m_offset;
+        }
+        if (!valid) {
+            throw std::runtime_error("Invalid snapshot index entry");
+        }
+    }
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    munmap(const_cast<char*>(m_data), m_size);
+}
+
+std::string SnapshotFile::key(std::size_t i) const
+{
+    auto &entry = index(i);
+    return std::string(m_data + entry.m_keyOffset, entry.m_keySize);
+}
+
+RecordMask SnapshotFile::records(std::size_t i) const
+{
+    return index(i).m_loaded & Entry::ALL_RECORDS;
+}
+
+void SnapshotFile::load(std::size_t i, Entry &entry) const
+{
+    auto &e = index(i);
+    auto self = shared_from_this();
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (e.m_loaded & (RecordMask(1) << idx)) {
+            auto &record = e.m_records[idx];
+            entry.refresh(idx, std::shared_ptr<const char>(self, m_data + record.m_offset), record.m_size);
+        }
+    }
+}
+
+std::size_t SnapshotFile::size(std::size_t i, std::size_t idx) const
+{
+    return index(i).m_records[idx].m_size;
+}
+
+std::string SnapshotFile::digest(std::size_t i, std::size_t idx) const
+{
+    static const char hex[] = "0123456789abcdef";
+    auto &record = index(i).m_records[idx];
+    std::string digest;
+    for (auto byte: record.m_digest) {
+        digest += hex[byte >> 4];
+        digest += hex[byte & 0xf];
+    }
+    return digest;
+}
+
+bool SnapshotFile::empty(std::size_t i, std::size_t idx) const
+{
+    auto &record = index(i).m_records[idx];
+    dict::WireHeader header;
+    if (record.m_size < sizeof(header)) {
+        return record.m_size == 0;
+    }
+    memcpy(&header, m_data + record.m_offset, sizeof(header));
+    return record.m_size == sizeof(header) && header.m_magic == dict::WIRE_MAGIC && header.m_count == 0;
+}
+
+const SnapshotIndex &SnapshotFile::index(std::size_t i) const
+{
+    if (i >= m_count) {
+        throw std::out_of_range("Snapshot entry out of range");
+    }
+    return m_index[i];
+}
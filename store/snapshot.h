@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "entry.h"
+
+/**
+ * @brief Snapshot files hold Entries as the compact serialized form of their records, so a
+ *        file can be mapped and its records read in place.  The file starts with a
+ *        SnapshotHeader, followed by the keys and records (each 8-byte aligned) and then an
+ *        index of m_count SnapshotIndex elements at m_indexOffset.  Snapshots are only read
+ *        back on hosts of the same byte order.
+ */
+struct SnapshotHeader {
+    uint32_t m_magic;
+    uint16_t m_version;
+    uint16_t m_records;
+    uint32_t m_valueSize;
+    uint32_t m_reserved;
+    uint64_t m_count;
+    uint64_t m_indexOffset;
+};
+
+struct SnapshotIndex {
+    uint64_t m_keyOffset;
+    uint32_t m_keySize;
+    // Records present in the snapshot
+    RecordMask m_loaded;
+    struct {
+        uint64_t m_offset;
+        uint64_t m_size;
+        // SHA1 of the record, checked server-side against its hash field
+        uint8_t m_digest[20];
+    } m_records[Entry::RECORDS];
+};
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x4e534446;  // "FDSN"
+constexpr uint16_t SNAPSHOT_VERSION = 2;
+
+/**
+ * @brief The SnapshotWriter class writes a snapshot to a temporary file next to its path and
+ *        renames it into place on commit(), so readers never see a partial snapshot.  Write
+ *        errors throw std::system_error.
+ */
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string &path);
+
+    /**
+     * @brief Remove the temporary file unless the snapshot was committed
+     */
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter &) = delete;
+
+    /**
+     * @brief Append the loaded records of an entry
+     */
+    void add(const std::string &key, Entry &entry);
+
+    /**
+     * @brief Write the index and header, flush the file to disk and rename it into place
+     *
+     * @return std::size_t - number of entries written
+     */
+    std::size_t commit();
+
+private:
+    uint64_t append(const char *data, std::size_t size);
+
+    std::string m_path;
+    std::string m_tmpPath;
+    FILE *m_file;
+    uint64_t m_offset;
+    std::vector<SnapshotIndex> m_index;
+};
+
+/**
+ * @brief The SnapshotFile class maps a snapshot read-only.  Pages are faulted in as records
+ *        are read, and Entries loaded from it view the mapping rather than copy it, keeping
+ *        it mapped for as long as any of them is alive.
+ */
+class SnapshotFile: public std::enable_shared_from_this<SnapshotFile> {
+public:
+    /**
+     * @brief Map a snapshot and check its header and index bounds
+     *
+     * @param path - snapshot path
+     * @return std::shared_ptr<SnapshotFile> - mapped snapshot.  throws std::system_error if
+     *                                         it cannot be mapped, std::runtime_error if invalid
+     */
+    static std::shared_ptr<SnapshotFile> open(const std::string &path);
+
+    ~SnapshotFile();
+
+    SnapshotFile(const SnapshotFile &) = delete;
+    SnapshotFile& operator=(const SnapshotFile &) = delete;
+
+    /**
+     * @brief Return the number of entries
+     */
+    std::size_t size() const {
+        return m_count;
+    }
+
+    std::string key(std::size_t i) const;
+
+    /**
+     * @brief Return the records present for an entry
+     */
+    RecordMask records(std::size_t i) const;
+
+    /**
+     * @brief Load the records present for an entry as views over the mapping, leaving the
+     *        others as they are.  throws std::runtime_error if a record is invalid.
+     */
+    void load(std::size_t i, Entry &entry) const;
+
+    /**
+     * @brief Return the size of a record of an entry
+     */
+    std::size_t size(std::size_t i, std::size_t idx) const;
+
+    /**
+     * @brief Return the SHA1 digest of a record of an entry, in the lowercase hex form of
+     *        redis.sha1hex()
+     */
+    std::string digest(std::size_t i, std::size_t idx) const;
+
+    /**
+     * @brief Return indication of whether a record of an entry is empty, so that an absent
+     *        hash field matches it.  An empty record is saved as a bare header.
+     */
+    bool empty(std::size_t i, std::size_t idx) const;
+
+private:
+    SnapshotFile(const char *data, std::size_t size);
+
+    const SnapshotIndex &index(std::size_t i) const;
+
+    const char *m_data;
+    std::size_t m_size;
+    std::size_t m_count;
+    const SnapshotIndex *m_index;
+};
@@ -7,6 +7,9 @@
 #include <unordered_map>
 #include <initializer_list>
 #include "store.h"
+#if STORE_ASYNC
+#include "asyncstore.h"
+#endif
 
 using namespace sw::redis;
 
@@ -24,7 +27,7 @@ std::vector<std::string> split(const std::string &str, const char delim)
 
 void usage() {
     std::cerr << "Usage\n"
-              << "hash-driver [-h <redisHost> ][-p <redisPort>][-e <redisAuthEnvVar>][-l <logLevel>]\n";
+              << "hash-driver [-h <redisHost> ][-p <redisPort>][-e <redisAuthEnvVar>][-l <logLevel>][-m <cacheBytes>][-t][-b <maxBatch>][-H]\n";
 
 }
 
@@ -37,9 +40,10 @@ int main(int argc, char**argv)
     std::string redisAuthEnvVar ("REDIS_PASSWORD");
     std::vector<uint16_t> sentinelPorts;
     int conSize = 5;
+    StoreOptions storeOptions;
     int c;
 
-    while ((c = getopt(argc,argv, "h:p:e:l:c:s:?")) != EOF) {
+    while ((c = getopt(argc,argv, "h:p:e:l:c:s:m:tb:H?")) != EOF) {
         switch (c) {
             case 'h':
                 redisHost = optarg;
@@ -60,6 +64,18 @@ int main(int argc, char**argv)
             case 'l':
                 logLevel = std::stoi(optarg);
                 break;
+            case 'm':
+                storeOptions.m_cacheBytes = static_cast<std::size_t>(std::stoull(optarg));
+                break;
+            case 't':
+                storeOptions.m_tracking = true;
+                break;
+            case 'b':
+                storeOptions.m_maxBatch = static_cast<std::size_t>(std::stoull(optarg));
+                break;
+            case 'H':
+                storeOptions.m_hugePages = true;
+                break;
             default:
                 usage();
                 exit(1);
@@ -109,7 +125,17 @@ int main(int argc, char**argv)
             redis = std::make_shared<Redis>(options, poolOptions);
         }
 
-        Store store(redis,logger);
+        Store store(redis,logger,storeOptions);
+
+#if STORE_ASYNC
+        std::unique_ptr<AsyncStore> asyncStore;
+        if (sentinelPorts.empty()) {
+            auto asyncRedis = std::make_shared<AsyncRedis>(options, poolOptions);
+            asyncStore.reset(new AsyncStore(asyncRedis, logger, store.cache(), store.tracker(), store.pool()));
+        } else {
+            logger->warn("AsyncStore not available with Sentinel");
+        }
+#endif
 
         while (true) {
             std::string line;
@@ -123,36 +149,109 @@ int main(int argc, char**argv)
                 std::string key = words[1];
                 Entry entry(key);
                 for (int x = 1; x < 10; x++) {
-                    entry.getRecord1().insert(x*100, x);
+                    if (!entry.getRecord1().insert(x*100, x)) {
+                        logger->warn("Entry {} unable to insert key {}", key, x*100);
+                    }
                 }
                 entry.dump(logger);
 
                 store.storeEntry(key, entry);
             } else if (words[0] == "get") {
                 std::string key = words[1];
-                Entry *entryPtr = nullptr;
-                if (store.queryEntry(words[1],entryPtr)) {
-                    entryPtr->dump(logger);
+                // Optionally followed by the names of the records to read
+                RecordMask records = words.size() > 2 ? 0 : Entry::ALL_RECORDS;
+                for (auto name = words.begin() + 2; name < words.end(); ++name) {
+                    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+                        if (*name == Entry::name(idx)) {
+                            records |= RecordMask(1) << idx;
+                        }
+                    }
+                }
+                EntryHandle entry;
+                if (records && store.queryEntry(words[1],entry,records)) {
+                    entry->dump(logger);
                 }
             } else if (words[0] == "del") {
                 std::string key = words[1];
                 store.deleteEntry(key);
             } else if (words[0] == "mod") {
                 std::string key = words[1];
-                Entry *entryPtr = nullptr;
-                if (store.queryEntry(words[1],entryPtr)) {
+                EntryHandle snapshot;
+                if (store.queryEntry(words[1],snapshot,Entry::mask<Record1>())) {
+                    Entry entry(*snapshot);
                     uint32_t mult = 0;
-                    auto &record = entryPtr->getRecord1();
-                    if (!record.contains(999)) {
-                        record.insert(999,2);
+                    auto &record = entry.getRecord1();
+                    if (!record.contains(999) && !record.insert(999,2)) {
+                        logger->warn("Entry {} unable to insert key {}", key, 999);
+                        continue;
                     }
                     mult = record.at(999).m_value + 1;
                     record.set(999,mult);
                     for (int x = 1; x < 10; x++) {
-                        entryPtr->getRecord1().set(x*100,x*mult);
+                        entry.getRecord1().set(x*100,x*mult);
+                    }
+                    store.patchEntry(words[1],entry);
+                }
+            } else if (words[0] == "incr") {
+                // incr key field [delta]: adds the field if absent, then increments it server-side
+                std::string key = words[1];
+                auto field = static_cast<uint32_t>(std::stoul(words[2]));
+                auto delta = words.size() > 3 ? static_cast<uint32_t>(std::stoul(words[3])) : 1u;
+                std::vector<OptionalLongLong> results;
+                if (store.updateEntry(key, Entry::index<Record1>(), {
+                        { EntryUpdate::INSERT, field, 0 },
+                        { EntryUpdate::INCR, field, delta } }, results) && results.size() == 2 && results[1]) {
+                    logger->info("Entry {} key {} is now {}", key, field, *results[1]);
+                }
+            } else if (words[0] == "mentry") {
+                std::vector<std::string> keys(words.begin() + 1, words.end());
+                std::vector<Entry> entries;
+                for (const auto &key: keys) {
+                    entries.emplace_back(key);
+                    for (int x = 1; x < 10; x++) {
+                        entries.back().getRecord1().insert(x*100, x);
+                    }
+                }
+                store.storeEntries(keys, entries);
+            } else if (words[0] == "mget") {
+                std::vector<std::string> keys(words.begin() + 1, words.end());
+                for (const auto &entry: store.queryEntries(keys)) {
+                    if (entry) {
+                        entry->dump(logger);
+                    }
+                }
+            } else if (words[0] == "mdel") {
+                std::vector<std::string> keys(words.begin() + 1, words.end());
+                store.deleteEntries(keys);
+#if STORE_ASYNC
+            } else if (words[0] == "aget" && asyncStore) {
+                std::vector<std::future<EntryHandle>> results;
+                for (auto key = words.begin() + 1; key != words.end(); ++key) {
+                    results.push_back(asyncStore->queryEntry(*key));
+                }
+                for (auto &result: results) {
+                    auto entry = result.get();
+                    if (entry) {
+                        entry->dump(logger);
                     }
-                    store.storeEntry(words[1],*entryPtr);
                 }
+#endif
+            } else if (words[0] == "preload") {
+                // preload pattern [threads]
+                std::size_t threads = words.size() > 2 ? static_cast<std::size_t>(std::stoul(words[2])) : 4;
+                store.preload(words[1], threads);
+            } else if (words[0] == "save") {
+                store.saveSnapshot(words[1]);
+            } else if (words[0] == "load") {
+                store.loadSnapshot(words[1]);
+            } else if (words[0] == "stats") {
+                auto stats = store.cacheStats();
+                logger->info("Cache entries {} bytes {} hits {} misses {} evictions {}", stats.m_entries,
+                             stats.m_bytes, stats.m_hits, stats.m_misses, stats.m_evictions);
+                auto pool = store.poolStats();
+                logger->info("Pool slots in use {} of {} bytes allocations {} frees {} oversize {} slabs {} ({} huge)",
+                             pool.m_slotsInUse, pool.m_slotBytes, pool.m_allocations, pool.m_frees,
+                             pool.m_oversize, pool.m_slabs, pool.m_hugeSlabs);
             }
 
         }
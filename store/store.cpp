@@ -1,33 +1,317 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <spdlog/spdlog.h>
 #include "store.h"
 
-Store::Store(std::shared_ptr<sw::redis::Redis> redis, std::shared_ptr<spdlog::logger> logger): m_redis(redis), m_logger(logger)
-{
+/**
+ * @brief Patch value bytes of a compact serialized Dict held in a hash field.
+ *        KEYS[1] - hash key
+ *        ARGV[1] - hash field, ARGV[2] - expected record size, ARGV[3] - expected keys hash
+ *        ARGV[4..] - pairs of byte offset and replacement bytes
+ *        Returns 1 if patched, 0 if the stored record does not have the expected size, format
+ *        version (dict::WIRE_VERSION) and keys
+ */
+static const char *PATCH_SCRIPT = R"lua(
+local blob = redis.call('HGET', KEYS[1], ARGV[1])
+if not blob or #blob ~= tonumber(ARGV[2]) or string.byte(blob, 5) ~= 2 or string.sub(blob, 13, 16) ~= ARGV[3] then
+    return 0
+end
+local parts = {}
+local pos = 1
+for i = 4, #ARGV, 2 do
+    local offset = tonumber(ARGV[i])
+    parts[#parts + 1] = string.sub(blob, pos, offset)
+    parts[#parts + 1] = ARGV[i + 1]
+    pos = offset + #ARGV[i + 1] + 1
+end
+parts[#parts + 1] = string.sub(blob, pos)
+redis.call('HSET', KEYS[1], ARGV[1], table.concat(parts))
+return 1
+)lua";
+
+static_assert(dict::WIRE_VERSION == 2, "PATCH_SCRIPT and UPDATE_SCRIPT hardcode the wire format version");
+
+/**
+ * @brief Apply changes to a serialized Dict held in a hash field, see Store::updateEntry().
+ *        The record is rewritten in the compact form of the current version, a legacy
+ *        fixed-size or version 1 record is converted.
+ *        Values are little-endian with the uint32_t value in their first 4 bytes.
+ *        KEYS[1] - hash key
+ *        ARGV[1] - hash field, ARGV[2] - record capacity, ARGV[3] - value size
+ *        ARGV[4..] - triples of operation (incr, set or insert), key and value
+ *        Returns the result of each change
+ */
+static const char *UPDATE_SCRIPT = R"lua(
+local function getU32(s, pos)
+    local a, b, c, d = string.byte(s, pos, pos + 3)
+    return a + b * 256 + c * 65536 + d * 16777216
+end
+local function putU32(v)
+    return string.char(v % 256, math.floor(v / 256) % 256, math.floor(v / 65536) % 256,
+                       math.floor(v / 16777216) % 256)
+end
+-- FNV-1a step modulo 2^32 without exceeding the 53-bit precision of a Lua number:
+-- h * 16777619 = h * 403 + h * 2^24
+local function hashWord(h, word)
+    h = bit.bxor(h, word) % 4294967296
+    return (h * 403 + (h % 256) * 16777216) % 4294967296
+end
+
+local capacity = tonumber(ARGV[2])
+local valueSize = tonumber(ARGV[3])
+local padding = string.rep('\0', valueSize - 4)
+local blob = redis.call('HGET', KEYS[1], ARGV[1])
+-- keys[i] = { key, value index }, values[index + 1] = value bytes
+local keys, values = {}, {}
+local layout = 0
+local rewrite = false
+if blob then
+    local count, keysOffset, valuesOffset
+    if #blob >= 16 and getU32(blob, 1) == 0x54434446 then
+        local version = string.byte(blob, 5)
+        if (version ~= 1 and version ~= 2) or string.byte(blob, 7) + string.byte(blob, 8) * 256 ~= valueSize then
+            return redis.error_reply('Unsupported record format')
+        end
+        layout = string.byte(blob, 6)
+        count = getU32(blob, 9)
+        keysOffset = 16
+        valuesOffset = 16 + count * 8
+        if count > capacity or #blob ~= valuesOffset + count * valueSize then
+            return redis.error_reply('Invalid record size')
+        end
+    elseif #blob == 8 + capacity * (8 + valueSize) then
+        count = getU32(blob, 1)
+        keysOffset = 8
+        valuesOffset = 8 + capacity * 8
+        if count > capacity then
+            return redis.error_reply('Invalid record content')
+        end
+        rewrite = true
+    else
+        return redis.error_reply('Invalid record size')
+    end
+    for i = 0, count - 1 do
+        local pos = keysOffset + i * 8 + 1
+        keys[#keys + 1] = { getU32(blob, pos + 4), getU32(blob, pos) }
+        values[i + 1] = string.sub(blob, valuesOffset + i * valueSize + 1, valuesOffset + (i + 1) * valueSize)
+    end
+end
+
+local function findKey(key)
+    for i = 1, #keys do
+        if keys[i][1] == key then
+            return keys[i][2] + 1
+        end
+    end
+    return nil
+end
+
+local reshaped = false
+local results = {}
+for i = 4, #ARGV, 3 do
+    local op, key, value = ARGV[i], tonumber(ARGV[i + 1]), tonumber(ARGV[i + 2])
+    local slot = findKey(key)
+    local result = 0
+    if op == 'incr' then
+        result = false
+        if slot then
+            local v = values[slot]
+            result = (getU32(v, 1) + value) % 4294967296
+            values[slot] = putU32(result) .. string.sub(v, 5)
+            rewrite = true
+        end
+    elseif op == 'set' then
+        if slot then
+            values[slot] = putU32(value) .. padding
+            rewrite = true
+            result = 1
+        end
+    elseif op == 'insert' then
+        if not slot and #keys < capacity then
+            keys[#keys + 1] = { key, #values }
+            values[#values + 1] = putU32(value) .. padding
+            rewrite = true
+            reshaped = true
+            result = 1
+        end
+    else
+        return redis.error_reply('Unknown operation ' .. op)
+    end
+    results[#results + 1] = result
+end
 
+if rewrite then
+    -- A record with keys added is written back with its keys sorted
+    if reshaped then
+        table.sort(keys, function (a, b) return a[1] < b[1] end)
+        layout = 0
+    end
+    local parts = {}
+    local hash = 2166136261
+    for i = 1, #keys do
+        parts[#parts + 1] = putU32(keys[i][2]) .. putU32(keys[i][1])
+        hash = hashWord(hashWord(hash, keys[i][2]), keys[i][1])
+    end
+    local header = putU32(0x54434446) .. string.char(2, layout, valueSize % 256, math.floor(valueSize / 256)) ..
+                   putU32(#keys) .. putU32(hash)
+    redis.call('HSET', KEYS[1], ARGV[1], header .. table.concat(parts) .. table.concat(values))
+end
+return results
+)lua";
+
+Store::Store(std::shared_ptr<sw::redis::Redis> redis, std::shared_ptr<spdlog::logger> logger, const StoreOptions &options):
+    m_redis(redis), m_logger(logger), m_pool(EntryPool::create(entrySlotBytes(), options.m_hugePages)),
+    m_cache(std::make_shared<EntryCache>(options.m_cacheBytes)), m_maxBatch(std::max<std::size_t>(options.m_maxBatch, 1)), m_revalidating(false)
+{
+    if (options.m_tracking) {
+        m_tracker = std::make_shared<KeyTracker>(redis, logger);
+    }
 }
 
 Store::~Store()
 {
+    std::lock_guard<std::mutex> lock(m_revalidatorMutex);
+    stopRevalidation();
+}
+
+/**
+ * @brief Check snapshot records against the hash fields they were saved from without returning
+ *        the fields.  A record matches if its field has the same size and SHA1 digest, or if
+ *        the field is absent and the record is empty.
+ *        KEYS - hash keys
+ *        ARGV - for each key, its number of records followed by a quadruple per record of hash
+ *        field, record size, digest and whether an absent field matches ('1' or '0')
+ *        Returns 1 for each key whose records all match, 0 otherwise
+ */
+static const char *VERIFY_SCRIPT = R"lua(
+local matches = {}
+local a = 1
+for k = 1, #KEYS do
+    local match = 1
+    local records = tonumber(ARGV[a])
+    for r = 1, records do
+        local field, size, digest, empty = ARGV[a + 1], tonumber(ARGV[a + 2]), ARGV[a + 3], ARGV[a + 4]
+        a = a + 4
+        if match == 1 then
+            local blob = redis.call('HGET', KEYS[k], field)
+            if blob then
+                if #blob ~= size or redis.sha1hex(blob) ~= digest then
+                    match = 0
+                end
+            elseif empty ~= '1' then
+                match = 0
+            end
+        end
+    end
+    a = a + 1
+    matches[k] = match
+end
+return matches
+)lua";
 
+/**
+ * @brief Return the hash field names of the selected records, in position order
+ */
+static std::vector<StringView> recordNames(RecordMask records)
+{
+    std::vector<StringView> names;
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (records & (RecordMask(1) << idx)) {
+            names.emplace_back(Entry::name(idx));
+        }
+    }
+    return names;
+}
+
+/**
+ * @brief Return the hash fields to HMSET to write the selected records
+ */
+static std::vector<std::pair<StringView, StringView>> recordFields(Entry &entry, RecordMask records)
+{
+    std::vector<std::pair<StringView, StringView>> fields;
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (records & (RecordMask(1) << idx)) {
+            fields.emplace_back(Entry::name(idx), StringView(entry.data(idx), entry.size(idx)));
+        }
+    }
+    return fields;
 }
 
 void Store::storeEntry(const std::string &key, Entry &entry)
 {
+    auto dirty = entry.dirty();
+    if (!dirty) {
+        return;
+    }
     try {
 
-        std::unordered_map<std::string, StringView> records {
-            { "record1", { entry.data(0), entry.size(0) } }
-        };
+        auto fields = recordFields(entry, dirty);
 
-        m_redis->hmset(key, records.begin(), records.end());
-        
-        if (m_entries.count(key) == 0) {
-            m_entries[key] = new Entry(entry);
-        } else {
-            *m_entries[key] = entry;
+        auto writeStamp = stamp(key);
+        m_redis->hmset(key, fields.begin(), fields.end());
+
+        entry.clean();
+        cacheEntry(key, entry, dirty, writeStamp);
+
+        m_logger->info("Stored entry {} ({} records)", key, fields.size());
+
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+    } catch (std::exception &e) {
+        m_logger->error("Caught std::exception {}", e.what());
+    }
+}
+
+void Store::patchEntry(const std::string &key, Entry &entry)
+{
+    auto dirty = entry.dirty();
+    if (!dirty) {
+        return;
+    }
+    try {
+        auto writeStamp = stamp(key);
+        // Records written in full, either reshaped or no longer matching the stored keys
+        RecordMask full = 0;
+        std::size_t ranges = 0;
+        for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+            auto record = RecordMask(1) << idx;
+            if (!(dirty & record)) {
+                continue;
+            }
+            if (!entry.patchable(idx)) {
+                full |= record;
+                continue;
+            }
+            uint32_t keysHash = entry.keysHash(idx);
+            std::vector<std::string> args {
+                Entry::name(idx),
+                std::to_string(entry.size(idx)),
+                std::string(reinterpret_cast<const char*>(&keysHash), sizeof(keysHash))
+            };
+            entry.forEachDirtyRange(idx, [&] (std::size_t offset, const char *bytes, std::size_t length) {
+                args.push_back(std::to_string(offset));
+                args.emplace_back(bytes, length);
+            });
+            if (evalScript<long long>(m_patchSha, PATCH_SCRIPT, { key }, args) == 0) {
+                m_logger->info("Stored entry {} record {} changed shape, storing in full", key, Entry::name(idx));
+                full |= record;
+                continue;
+            }
+            ranges += (args.size() - 3) / 2;
         }
+        if (full) {
+            auto fields = recordFields(entry, full);
+            m_redis->hmset(key, fields.begin(), fields.end());
+        }
+
+        entry.clean();
+        // Values of a patched record left untouched may have been changed by another writer
+        cacheEntry(key, entry, full, writeStamp);
 
-        m_logger->info("Stored entry {}", key);
+        m_logger->info("Patched entry {} ({} ranges)", key, ranges);
 
     } catch (const sw::redis::Error &e) {
         m_logger->error("Caught Redis exception {}", e.what());
@@ -36,11 +320,49 @@ void Store::storeEntry(const std::string &key, Entry &entry)
     }
 }
 
+bool Store::updateEntry(const std::string &key, std::size_t idx, const std::vector<EntryUpdate> &updates,
+                        std::vector<OptionalLongLong> &results)
+{
+    static_assert(offsetof(Value, m_value) == 0 && sizeof(Value::m_value) == 4,
+                  "UPDATE_SCRIPT expects the uint32_t value first");
+    static const char *OPS[] = { "incr", "set", "insert" };
+    if (idx >= Entry::RECORDS) {
+        m_logger->error("updateEntry() given record {} of {}", idx, Entry::RECORDS);
+        return false;
+    }
+    try {
+        std::vector<std::string> args {
+            Entry::name(idx),
+            std::to_string(Entry::capacity(idx)),
+            std::to_string(sizeof(Value))
+        };
+        for (const auto &update: updates) {
+            args.push_back(OPS[update.m_op]);
+            args.push_back(std::to_string(update.m_key));
+            args.push_back(std::to_string(update.m_value));
+        }
+
+        results = evalScript<std::vector<OptionalLongLong>>(m_updateSha, UPDATE_SCRIPT, { key }, args);
+        // The cached copy no longer matches, whether or not tracking reports the change
+        m_cache->erase(key);
+
+        m_logger->info("Updated entry {} ({} changes)", key, updates.size());
+        return true;
+
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+    } catch (std::exception &e) {
+        m_logger->error("Caught std::exception {}", e.what());
+    }
+    return false;
+}
+
 void Store::deleteEntry(const std::string &key)
 {
     try {
         m_logger->info("Removed entry {}", key);
         m_redis->unlink(key);
+        m_cache->erase(key);
 
     } catch (const sw::redis::Error &e) {
         m_logger->error("Caught Redis exception {}", e.what());
@@ -50,34 +372,502 @@ void Store::deleteEntry(const std::string &key)
 
 }
 
-bool Store::queryEntry(const std::string &key, Entry *&entry)
+bool Store::queryEntry(const std::string &key, EntryHandle &entry, RecordMask records)
 {
-    if (m_entries.count(key)) {
-        // TODO: Refresh existing entry from Redis
+    records &= Entry::ALL_RECORDS;
+    try {
+        // Stamp before the lookup and the read so a change notified meanwhile invalidates both
+        auto readStamp = stamp(key);
+        auto current = currentEntry(key);
+        if (current && (current->loaded() & records) == records) {
+            entry = current;
+            return true;
+        }
+        auto names = recordNames(records);
+        std::vector<OptionalString> fields;
+        m_redis->hmget(key, names.begin(), names.end(), std::back_inserter(fields));
+        entry = readEntry(key, current, records, fields);
+        m_cache->put(key, entry, readStamp);
+        return true;
+    } catch (const sw::redis::Error &e) {
+        m_logger->error("Caught Redis exception {}", e.what());
+    } catch (std::exception &e) {
+        m_logger->error("Caught std::exception {}", e.what());
+    }
+    return false;
+}
+
+std::vector<bool> Store::storeEntries(const std::vector<std::string> &keys, std::vector<Entry> &entries)
+{
+    std::vector<bool> results(keys.size(), false);
+    if (entries.size() != keys.size()) {
+        m_logger->error("storeEntries() given {} keys and {} entries", keys.size(), entries.size());
+        return results;
+    }
+    for (std::size_t first = 0; first < keys.size(); first += m_maxBatch) {
+        std::size_t last = std::min(keys.size(), first + m_maxBatch);
         try {
-            std::unordered_map<std::string, std::string> fields;
-            m_redis->hgetall(key, std::inserter(fields, fields.end()));
-            m_entries.at(key)->refresh(fields);
-            entry = m_entries[key];
-            
+            auto pipe = m_redis->pipeline(false);
+            // Entries with dirty records, with the records written and the stamp taken before
+            std::vector<std::size_t> writes;
+            std::vector<RecordMask> written;
+            std::vector<uint64_t> writeStamps;
+            for (std::size_t i = first; i < last; i++) {
+                auto dirty = entries[i].dirty();
+                if (!dirty) {
+                    results[i] = true;
+                    continue;
+                }
+                auto fields = recordFields(entries[i], dirty);
+                writes.push_back(i);
+                written.push_back(dirty);
+                writeStamps.push_back(stamp(keys[i]));
+                pipe.hmset(keys[i], fields.begin(), fields.end());
+            }
+            if (writes.empty()) {
+                continue;
+            }
+            auto replies = pipe.exec();
+            for (std::size_t w = 0; w < writes.size(); w++) {
+                auto i = writes[w];
+                try {
+                    replies.get(w);
+                    entries[i].clean();
+                    cacheEntry(keys[i], entries[i], written[w], writeStamps[w]);
+                    results[i] = true;
+                } catch (const sw::redis::Error &e) {
+                    m_logger->error("Unable to store entry {}: {}", keys[i], e.what());
+                }
+            }
+        } catch (const sw::redis::Error &e) {
+            m_logger->error("Caught Redis exception {}", e.what());
+        } catch (std::exception &e) {
+            m_logger->error("Caught std::exception {}", e.what());
+        }
+    }
+    m_logger->info("Stored {} of {} entries", std::count(results.begin(), results.end(), true), keys.size());
+    return results;
+}
 
+std::vector<EntryHandle> Store::queryEntries(const std::vector<std::string> &keys, RecordMask records)
+{
+    std::size_t cached = 0;
+    auto results = readEntries(keys, records, cached);
+    m_logger->info("Read {} entries ({} from cache)", keys.size(), cached);
+    return results;
+}
+
+std::vector<EntryHandle> Store::readEntries(const std::vector<std::string> &keys, RecordMask records,
+                                           std::size_t &cached)
+{
+    records &= Entry::ALL_RECORDS;
+    std::vector<EntryHandle> results(keys.size());
+    // Keys that need reading from Redis, with their current cached copy and the stamp taken
+    // before looking it up
+    std::vector<std::size_t> reads;
+    std::vector<EntryHandle> currents;
+    std::vector<uint64_t> readStamps;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        auto readStamp = stamp(keys[i]);
+        auto current = currentEntry(keys[i]);
+        if (current && (current->loaded() & records) == records) {
+            results[i] = current;
+        } else {
+            reads.push_back(i);
+            currents.push_back(current);
+            readStamps.push_back(readStamp);
+        }
+    }
+    auto names = recordNames(records);
+    for (std::size_t first = 0; first < reads.size(); first += m_maxBatch) {
+        std::size_t last = std::min(reads.size(), first + m_maxBatch);
+        try {
+            auto pipe = m_redis->pipeline(false);
+            for (std::size_t r = first; r < last; r++) {
+                pipe.hmget(keys[reads[r]], names.begin(), names.end());
+            }
+            auto replies = pipe.exec();
+            for (std::size_t r = first; r < last; r++) {
+                auto i = reads[r];
+                try {
+                    std::vector<OptionalString> fields;
+                    replies.get(r - first, std::back_inserter(fields));
+                    auto entry = readEntry(keys[i], currents[r], records, fields);
+                    m_cache->put(keys[i], entry, readStamps[r]);
+                    results[i] = entry;
+                } catch (const sw::redis::Error &e) {
+                    m_logger->error("Unable to read entry {}: {}", keys[i], e.what());
+                } catch (std::exception &e) {
+                    m_logger->error("Unable to read entry {}: {}", keys[i], e.what());
+                }
+            }
         } catch (const sw::redis::Error &e) {
             m_logger->error("Caught Redis exception {}", e.what());
         } catch (std::exception &e) {
             m_logger->error("Caught std::exception {}", e.what());
         }
-        return true;
     }
+    cached = keys.size() - reads.size();
+    return results;
+}
+
+std::vector<bool> Store::deleteEntries(const std::vector<std::string> &keys)
+{
+    std::vector<bool> results(keys.size(), false);
+    for (std::size_t first = 0; first < keys.size(); first += m_maxBatch) {
+        std::size_t last = std::min(keys.size(), first + m_maxBatch);
+        try {
+            auto pipe = m_redis->pipeline(false);
+            for (std::size_t i = first; i < last; i++) {
+                pipe.unlink(keys[i]);
+            }
+            auto replies = pipe.exec();
+            for (std::size_t i = first; i < last; i++) {
+                try {
+                    replies.get<long long>(i - first);
+                    m_cache->erase(keys[i]);
+                    results[i] = true;
+                } catch (const sw::redis::Error &e) {
+                    m_logger->error("Unable to remove entry {}: {}", keys[i], e.what());
+                }
+            }
+        } catch (const sw::redis::Error &e) {
+            m_logger->error("Caught Redis exception {}", e.what());
+        } catch (std::exception &e) {
+            m_logger->error("Caught std::exception {}", e.what());
+        }
+    }
+    m_logger->info("Removed {} of {} entries", std::count(results.begin(), results.end(), true), keys.size());
+    return results;
+}
+
+PreloadProgress Store::preload(const std::string &pattern, std::size_t threads, RecordMask records,
+                               const PreloadCallback &progress)
+{
+    if (!m_tracker) {
+        m_logger->warn("Preload {} skipped, cached entries are only served with tracking", pattern);
+        return PreloadProgress();
+    }
+    // Bounded queue of key batches from the scanning thread to the readers
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::vector<std::string>> batches;
+    bool scanning = true;
+    std::atomic<std::size_t> loaded(0);
+    std::atomic<std::size_t> failed(0);
+    threads = std::max<std::size_t>(threads, 1);
+
+    std::vector<std::thread> readers;
+    for (std::size_t t = 0; t < threads; t++) {
+        readers.emplace_back([&] {
+            while (true) {
+                std::vector<std::string> keys;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&] { return !batches.empty() || !scanning; });
+                    if (batches.empty()) {
+                        return;
+                    }
+                    keys = std::move(batches.front());
+                    batches.pop_front();
+                }
+                ready.notify_all();
+                std::size_t cached = 0;
+                auto entries = readEntries(keys, records, cached);
+                auto read = static_cast<std::size_t>(std::count_if(entries.begin(), entries.end(),
+                    [] (const EntryHandle &entry) { return entry != nullptr; }));
+                loaded += read;
+                failed += keys.size() - read;
+            }
+        });
+    }
+
+    PreloadProgress status;
+    auto start = std::chrono::steady_clock::now();
+    auto reported = start;
+    auto report = [&] (bool final) {
+        auto now = std::chrono::steady_clock::now();
+        status.m_loaded = loaded.load();
+        status.m_failed = failed.load();
+        status.m_seconds = std::chrono::duration<double>(now - start).count();
+        if (final || now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            m_logger->info("Preload {}: scanned {} loaded {} failed {} ({:.0f} entries/s)", pattern, status.m_scanned,
+                           status.m_loaded, status.m_failed, status.m_seconds > 0 ? static_cast<double>(status.m_loaded) / status.m_seconds : 0.0);
+            if (progress) {
+                progress(status);
+            }
+        }
+    };
+
+    bool scanned = false;
     try {
-        std::unordered_map<std::string, std::string> fields;
-        m_redis->hgetall(key, std::inserter(fields, fields.end()));
-        m_entries[key] = new Entry(key, fields);
-        entry = m_entries[key];
-        return true;
+        long long cursor = 0;
+        std::vector<std::string> keys;
+        do {
+            auto pending = keys.size();
+            cursor = m_redis->scan(cursor, pattern, static_cast<long long>(m_maxBatch), std::back_inserter(keys));
+            status.m_scanned += keys.size() - pending;
+            while (keys.size() >= m_maxBatch || (cursor == 0 && !keys.empty())) {
+                std::size_t count = std::min(keys.size(), m_maxBatch);
+                std::vector<std::string> batch(std::make_move_iterator(keys.begin()),
+                                               std::make_move_iterator(keys.begin() + static_cast<std::ptrdiff_t>(count)));
+                keys.erase(keys.begin(), keys.begin() + static_cast<std::ptrdiff_t>(count));
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return batches.size() < 2 * threads; });
+                batches.push_back(std::move(batch));
+                lock.unlock();
+                ready.notify_all();
+            }
+            report(false);
+        } while (cursor != 0);
+        scanned = true;
     } catch (const sw::redis::Error &e) {
         m_logger->error("Caught Redis exception {}", e.what());
     } catch (std::exception &e) {
         m_logger->error("Caught std::exception {}", e.what());
     }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scanning = false;
+    }
+    ready.notify_all();
+    for (auto &reader: readers) {
+        reader.join();
+    }
+    status.m_complete = scanned && failed.load() == 0;
+    report(true);
+    return status;
+}
+
+bool Store::saveSnapshot(const std::string &path)
+{
+    try {
+        // Take the handles under the shard locks, then serialize and write without them
+        std::vector<std::pair<std::string, EntryHandle>> entries;
+        m_cache->forEach([&] (const std::string &key, const EntryHandle &entry, uint64_t) {
+            entries.emplace_back(key, entry);
+        });
+        SnapshotWriter writer(path);
+        for (auto &cached: entries) {
+            // data() may serialize into the Entry, cached snapshots are immutable
+            Entry copy(*cached.second);
+            writer.add(cached.first, copy);
+            cached.second.reset();
+        }
+        auto count = writer.commit();
+        m_logger->info("Saved {} entries to snapshot {}", count, path);
+        return true;
+    } catch (std::exception &e) {
+        m_logger->error("Unable to save snapshot {}: {}", path, e.what());
+    }
     return false;
 }
+
+bool Store::loadSnapshot(const std::string &path)
+{
+    if (!m_tracker) {
+        m_logger->warn("Snapshot {} not loaded, cached entries are only served with tracking", path);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_revalidatorMutex);
+    stopRevalidation();
+    std::shared_ptr<SnapshotFile> snapshot;
+    try {
+        snapshot = SnapshotFile::open(path);
+    } catch (std::exception &e) {
+        m_logger->error("Unable to load snapshot {}: {}", path, e.what());
+        return false;
+    }
+    m_logger->info("Mapped snapshot {} with {} entries", path, snapshot->size());
+    m_revalidating = true;
+    m_revalidator = std::thread(&Store::revalidate, this, snapshot);
+    return true;
+}
+
+void Store::revalidate(std::shared_ptr<SnapshotFile> snapshot)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::size_t checked = 0;
+    std::size_t changed = 0;
+    std::vector<std::size_t> batch;
+    std::vector<std::string> keys;
+    std::vector<std::string> args;
+    std::vector<uint64_t> readStamps;
+    std::vector<std::size_t> reads;
+    for (std::size_t first = 0; first < snapshot->size() && m_revalidating.load(); first += m_maxBatch) {
+        std::size_t last = std::min(snapshot->size(), first + m_maxBatch);
+        try {
+            batch.clear();
+            keys.clear();
+            args.clear();
+            readStamps.clear();
+            reads.clear();
+            for (std::size_t i = first; i < last; i++) {
+                auto key = snapshot->key(i);
+                // Skip keys a query has cached since, they were read after the snapshot was taken
+                if (m_cache->peek(key)) {
+                    continue;
+                }
+                auto records = snapshot->records(i);
+                batch.push_back(i);
+                readStamps.push_back(stamp(key));
+                keys.push_back(std::move(key));
+                args.push_back(std::to_string(recordNames(records).size()));
+                for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+                    if (records & (RecordMask(1) << idx)) {
+                        args.emplace_back(Entry::name(idx));
+                        args.push_back(std::to_string(snapshot->size(i, idx)));
+                        args.push_back(snapshot->digest(i, idx));
+                        args.emplace_back(snapshot->empty(i, idx) ? "1" : "0");
+                    }
+                }
+            }
+            if (batch.empty()) {
+                continue;
+            }
+            // Only a match bit per key comes back, the records of changed keys are read below
+            auto matches = evalScript<std::vector<long long>>(m_verifySha, VERIFY_SCRIPT, keys, args);
+            for (std::size_t n = 0; n < batch.size(); n++) {
+                if (n < matches.size() && matches[n]) {
+                    // Records are only parsed here, on their first access
+                    try {
+                        auto entry = makeEntry(m_pool, keys[n]);
+                        entry->unload(Entry::ALL_RECORDS);
+                        snapshot->load(batch[n], *entry);
+                        m_cache->put(keys[n], entry, readStamps[n]);
+                        checked++;
+                        continue;
+                    } catch (std::runtime_error &e) {
+                        m_logger->error("Snapshot entry {} invalid: {}", keys[n], e.what());
+                    }
+                }
+                reads.push_back(n);
+            }
+            if (reads.empty()) {
+                continue;
+            }
+            auto pipe = m_redis->pipeline(false);
+            for (auto n: reads) {
+                auto names = recordNames(snapshot->records(batch[n]));
+                pipe.hmget(keys[n], names.begin(), names.end());
+            }
+            auto replies = pipe.exec();
+            for (std::size_t r = 0; r < reads.size(); r++) {
+                auto n = reads[r];
+                try {
+                    std::vector<OptionalString> fields;
+                    replies.get(r, std::back_inserter(fields));
+                    m_cache->put(keys[n], readEntry(keys[n], nullptr, snapshot->records(batch[n]), fields), readStamps[n]);
+                    checked++;
+                    changed++;
+                } catch (const sw::redis::Error &e) {
+                    m_logger->error("Unable to revalidate entry {}: {}", keys[n], e.what());
+                } catch (std::exception &e) {
+                    m_logger->error("Unable to revalidate entry {}: {}", keys[n], e.what());
+                }
+            }
+        } catch (const sw::redis::Error &e) {
+            m_logger->error("Caught Redis exception {}", e.what());
+        } catch (std::exception &e) {
+            m_logger->error("Caught std::exception {}", e.what());
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    m_logger->info("Revalidated {} of {} snapshot entries ({} changed) in {} ms", checked, snapshot->size(),
+                   changed, elapsed.count());
+}
+
+void Store::stopRevalidation()
+{
+    m_revalidating = false;
+    if (m_revalidator.joinable()) {
+        m_revalidator.join();
+    }
+}
+
+EntryCache::Stats Store::cacheStats() const
+{
+    return m_cache->stats();
+}
+
+void Store::cacheEntry(const std::string &key, const Entry &entry, RecordMask written, uint64_t stamp)
+{
+    // Cache a snapshot, the caller keeps its Entry to modify
+    auto snapshot = makeEntry(m_pool, entry);
+    snapshot->unload(~written);
+    m_cache->put(key, snapshot, stamp);
+}
+
+EntryPool::Stats Store::poolStats() const
+{
+    return m_pool->stats();
+}
+
+EntryHandle Store::currentEntry(const std::string &key) const
+{
+    uint64_t cachedStamp = 0;
+    auto cached = m_cache->find(key, &cachedStamp);
+    if (cached && m_tracker && m_tracker->valid(key, cachedStamp)) {
+        return cached;
+    }
+    return nullptr;
+}
+
+EntryHandle Store::readEntry(const std::string &key, const EntryHandle &current, RecordMask records,
+                             std::vector<OptionalString> &fields) const
+{
+    // Replace rather than refresh the cached snapshot, other threads may be reading it
+    std::shared_ptr<Entry> entry;
+    if (current) {
+        entry = makeEntry(m_pool, *current);
+    } else {
+        entry = makeEntry(m_pool, key);
+        entry->unload(Entry::ALL_RECORDS);
+    }
+    std::size_t field = 0;
+    for (std::size_t idx = 0; idx < Entry::RECORDS; idx++) {
+        if (records & (RecordMask(1) << idx)) {
+            auto &value = fields.at(field++);
+            entry->refresh(idx, value ? std::move(*value) : std::string());
+        }
+    }
+    return entry;
+}
+
+uint64_t Store::stamp(const std::string &key) const
+{
+    return m_tracker ? m_tracker->stamp(key) : 0;
+}
+
+template<class Result>
+Result Store::evalScript(std::string &sha, const char *script, const std::vector<std::string> &keys,
+                         const std::vector<std::string> &args)
+{
+    std::string loaded;
+    {
+        std::lock_guard<std::mutex> lock(m_scriptMutex);
+        if (sha.empty()) {
+            sha = m_redis->script_load(script);
+        }
+        loaded = sha;
+    }
+    try {
+        return m_redis->evalsha<Result>(loaded, keys.begin(), keys.end(), args.begin(), args.end());
+    } catch (const sw::redis::ReplyError &e) {
+        // Script cache flushed (e.g. server restart or failover): load it again and retry once
+        if (std::string(e.what()).find("NOSCRIPT") == std::string::npos) {
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_scriptMutex);
+            // Another thread may have reloaded it already
+            if (sha == loaded) {
+                sha = m_redis->script_load(script);
+            }
+            loaded = sha;
+        }
+        return m_redis->evalsha<Result>(loaded, keys.begin(), keys.end(), args.begin(), args.end());
+    }
+}
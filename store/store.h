@@ -1,6 +1,16 @@
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <sw/redis++/redis++.h>
 #include "entry.h"
+#include "entrycache.h"
+#include "entrypool.h"
+#include "keytracker.h"
+#include "snapshot.h"
 
 #pragma once
 
@@ -10,21 +20,287 @@ namespace spdlog {
     class logger;
 }
 
+/**
+ * @brief Store configuration
+ */
+struct StoreOptions {
+    // Memory budget of the entry cache
+    std::size_t m_cacheBytes = EntryCache::DEFAULT_MAX_BYTES;
+    // Serve cached entries without a round trip until a keyspace notification reports the
+    // key changed (see KeyTracker)
+    bool m_tracking = false;
+    // Maximum number of commands sent in one pipeline by the batch calls
+    std::size_t m_maxBatch = 256;
+    // Back the EntryPool slabs with huge pages
+    bool m_hugePages = false;
+};
+
+/**
+ * @brief Progress of Store::preload()
+ */
+struct PreloadProgress {
+    // Keys returned by SCAN so far, duplicates included
+    std::size_t m_scanned = 0;
+    // Keys read and cached, or already cached and current
+    std::size_t m_loaded = 0;
+    std::size_t m_failed = 0;
+    double m_seconds = 0;
+    // The scan reached the end of the keyspace and every key was read
+    bool m_complete = false;
+};
+
+/**
+ * @brief A change applied to a record server-side by Store::updateEntry()
+ */
+struct EntryUpdate {
+    enum Op {
+        // Add m_value to the value of m_key, wrapping like uint32_t arithmetic
+        INCR,
+        // Replace the value of m_key
+        SET,
+        // Add m_key with value m_value
+        INSERT
+    };
+
+    Op m_op;
+    uint32_t m_key;
+    uint32_t m_value;
+};
+
+/**
+ * @brief The Store class reads and writes Entries kept in Redis hashes, caching them in an
+ *        EntryCache.  One Store may be shared by any number of threads: the cache hands out
+ *        immutable snapshots and the remaining state is internally synchronized.  An Entry
+ *        passed to storeEntry() or patchEntry() belongs to the calling thread.
+ */
 class Store {
 public:
-    Store(std::shared_ptr<Redis> redis, std::shared_ptr<spdlog::logger> logger);
+    /**
+     * @brief Construct a new Store object
+     *
+     * @param redis - Redis connection
+     * @param logger - logger
+     * @param options - cache and batching configuration
+     */
+    Store(std::shared_ptr<Redis> redis, std::shared_ptr<spdlog::logger> logger,
+          const StoreOptions &options = StoreOptions());
 
     ~Store();
 
+    /**
+     * @brief Store the loaded records of an entry changed since they were read or stored
+     */
     void storeEntry(const std::string &key, Entry &entry);
 
+    /**
+     * @brief Store only the record values changed with set() since the entry was last read or
+     *        stored, patching the stored records in place with a server-side script.  A record
+     *        is written in full instead if keys were added or removed or the stored record no
+     *        longer has the same keys.
+     */
+    void patchEntry(const std::string &key, Entry &entry);
+
+    /**
+     * @brief Apply changes to a stored record atomically in one round trip with a server-side
+     *        script, without reading the entry first.  The changes are applied in order; one
+     *        that cannot be applied is skipped and does not stop the others.  The cached copy
+     *        of the entry is dropped.
+     *
+     * @param key - Redis key
+     * @param idx - record position, an absent record is created empty
+     * @param updates - changes to apply
+     * @param results - per change result: INCR the new value, or no value if the key is
+     *                  absent; SET and INSERT 1 if applied, 0 if the key is absent (SET) or
+     *                  already present or the record is full (INSERT)
+     * @return true - script ran
+     * @return false - Redis error, or the stored record could not be parsed
+     */
+    bool updateEntry(const std::string &key, std::size_t idx, const std::vector<EntryUpdate> &updates,
+                     std::vector<OptionalLongLong> &results);
+
     void deleteEntry(const std::string &key);
 
-    bool queryEntry(const std::string &key, Entry *&entry);
+    /**
+     * @brief Read records of an entry from Redis with HMGET, refreshing the cached copy if
+     *        there is one.  With tracking enabled a cached copy no notification has invalidated
+     *        is returned as is when it holds the records asked for, and records it already holds
+     *        are kept when others are read.
+     *
+     * @param key - Redis key
+     * @param entry - handle to an immutable snapshot of the entry, valid even after it is
+     *                evicted.  Copy it to modify and store the entry.
+     * @param records - records to read, the others may not be loaded in the snapshot
+     * @return true - entry read
+     * @return false - Redis error
+     */
+    bool queryEntry(const std::string &key, EntryHandle &entry, RecordMask records = Entry::ALL_RECORDS);
+
+    /**
+     * @brief Store several entries, pipelining up to StoreOptions::m_maxBatch HMSETs per round trip
+     *
+     * @param keys - Redis keys
+     * @param entries - entries to store, one per key
+     * @return std::vector<bool> - per key indication of whether the entry was stored
+     */
+    std::vector<bool> storeEntries(const std::vector<std::string> &keys, std::vector<Entry> &entries);
+
+    /**
+     * @brief Read several entries, pipelining up to StoreOptions::m_maxBatch HMGETs per round
+     *        trip.  With tracking enabled only keys without a valid cached copy are read.
+     *
+     * @param keys - Redis keys
+     * @param records - records to read, see queryEntry()
+     * @return std::vector<EntryHandle> - per key handle, nullptr if the entry could not be read
+     */
+    std::vector<EntryHandle> queryEntries(const std::vector<std::string> &keys, RecordMask records = Entry::ALL_RECORDS);
+
+    /**
+     * @brief Remove several entries, pipelining up to StoreOptions::m_maxBatch UNLINKs per round trip
+     *
+     * @param keys - Redis keys
+     * @return std::vector<bool> - per key indication of whether the UNLINK succeeded
+     */
+    std::vector<bool> deleteEntries(const std::vector<std::string> &keys);
+
+    using PreloadCallback = std::function<void(const PreloadProgress&)>;
+
+    /**
+     * @brief Fill the cache with the entries matching a pattern.  The calling thread walks the
+     *        keyspace with SCAN MATCH and hands batches of StoreOptions::m_maxBatch keys to
+     *        reader threads, each reading its batch with pipelined HMGETs on its own pool
+     *        connection.  Keys with a current cached copy are not read again.
+     *        Requires tracking, without it nothing is read and m_complete is false.
+     *
+     * @param pattern - SCAN MATCH pattern
+     * @param threads - reader threads, at most the connection pool size is useful
+     * @param records - records to read
+     * @param progress - if set, called on the calling thread about once a second and at the end
+     * @return PreloadProgress - final counts
+     */
+    PreloadProgress preload(const std::string &pattern, std::size_t threads = 4,
+                            RecordMask records = Entry::ALL_RECORDS, const PreloadCallback &progress = nullptr);
+
+    /**
+     * @brief Write the cached entries to a snapshot file, replacing it atomically
+     *
+     * @param path - snapshot path
+     * @return true - snapshot written
+     * @return false - I/O error
+     */
+    bool saveSnapshot(const std::string &path);
+
+    /**
+     * @brief Map a snapshot file without reading its records.  A background pass, started
+     *        here, checks the record digests against Redis in batches and caches the entries;
+     *        records that still match are parsed then and cached as views over the mapping,
+     *        the others are read from Redis.  Entries are not served before they are checked.
+     *        Requires tracking, without it cached entries are never served.
+     *
+     * @param path - snapshot path
+     * @return true - snapshot loaded
+     * @return false - snapshot missing or invalid
+     */
+    bool loadSnapshot(const std::string &path);
+
+    /**
+     * @brief Return the entry cache hit, miss and eviction counters
+     */
+    EntryCache::Stats cacheStats() const;
+
+    /**
+     * @brief Return the entry pool allocation counters
+     */
+    EntryPool::Stats poolStats() const;
+
+    /**
+     * @brief Return the pool the entry snapshots are allocated from, to share it with an AsyncStore
+     */
+    std::shared_ptr<EntryPool> pool() const {
+        return m_pool;
+    }
+
+    /**
+     * @brief Return the entry cache, to share it with an AsyncStore
+     */
+    std::shared_ptr<EntryCache> cache() const {
+        return m_cache;
+    }
+
+    /**
+     * @brief Return the key tracker, nullptr unless tracking is enabled
+     */
+    std::shared_ptr<KeyTracker> tracker() const {
+        return m_tracker;
+    }
 
 private:
+    /**
+     * @brief Cache a snapshot of an entry just written.  Records not written in full are
+     *        dropped from the snapshot, they may differ from what is stored.
+     *
+     * @param written - records written in full
+     */
+    void cacheEntry(const std::string &key, const Entry &entry, RecordMask written, uint64_t stamp);
+
+    /**
+     * @brief Read several entries as queryEntries() does, without logging
+     *
+     * @param cached - receives the number of entries served from the cache
+     */
+    std::vector<EntryHandle> readEntries(const std::vector<std::string> &keys, RecordMask records,
+                                         std::size_t &cached);
+
+    /**
+     * @brief Return the cached copy of an entry if tracking shows it is current, else nullptr
+     */
+    EntryHandle currentEntry(const std::string &key) const;
+
+    /**
+     * @brief Build the snapshot of an entry read with HMGET
+     *
+     * @param key - Redis key
+     * @param current - current cached copy, whose other records are kept, or nullptr
+     * @param records - records read
+     * @param fields - HMGET reply, one field per record read
+     */
+    EntryHandle readEntry(const std::string &key, const EntryHandle &current, RecordMask records,
+                          std::vector<OptionalString> &fields) const;
+
+    uint64_t stamp(const std::string &key) const;
+
+    /**
+     * @brief Check the keys of a snapshot against Redis with VERIFY_SCRIPT, which compares
+     *        record digests server-side, and cache them.  Records that did not change view the
+     *        mapping, only keys that changed are read in full.  Keys already cached are skipped.
+     *        Runs on m_revalidator.
+     *
+     * @param snapshot - mapped snapshot
+     */
+    void revalidate(std::shared_ptr<SnapshotFile> snapshot);
+
+    /**
+     * @brief Stop m_revalidator and wait for it, the caller holds m_revalidatorMutex
+     */
+    void stopRevalidation();
+
+    template<class Result>
+    Result evalScript(std::string &sha, const char *script, const std::vector<std::string> &keys,
+                      const std::vector<std::string> &args);
+
     std::shared_ptr<Redis> m_redis;
     std::shared_ptr<spdlog::logger> m_logger;
-    std::map<std::string, Entry*> m_entries;
+    std::shared_ptr<EntryPool> m_pool;
+    std::shared_ptr<EntryCache> m_cache;
+    std::shared_ptr<KeyTracker> m_tracker;
+    // Guards the script SHA1s, loaded on first use
+    std::mutex m_scriptMutex;
+    std::string m_patchSha;
+    std::string m_updateSha;
+    std::string m_verifySha;
+    std::size_t m_maxBatch;
+    // Guards starting and stopping m_revalidator
+    std::mutex m_revalidatorMutex;
+    std::atomic_bool m_revalidating;
+    std::thread m_revalidator;
 
 };
\ No newline at end of file